@@ -16,27 +16,52 @@
 
 #include "./SPLITT.h"
 #include "./NumericTraitData.h"
+#include "./VectorMath.h"
+#include "./DualNumber.h"
 #include <iostream>
 
 namespace ThreePointUsingSPLITT {
 
 using namespace SPLITT;
 
-template<class Tree>
+// Storage is the scalar type used to store the per-node coefficients a and b
+// (double, float or a DualNumber). The coefficient c, which is summed over all
+// nodes, and all arithmetic use the type Value, i.e. double for double and
+// float storage (see the comments on Storage in ThreePointUnivariate.h). The
+// children of an internal node are summed into the ChildSums sum_a and sum_b,
+// which are side accumulators of type Value only for float storage. With
+// dual number storage, the derivatives with respect to x0, alpha, theta,
+// sigma2 and sigmae2 are returned after the log-likelihood.
+template<class Tree, class Storage = double>
 class AbcPOUMM: public TraversalSpecification<Tree> {
 
 public:
-  typedef AbcPOUMM<Tree> MyType;
+  typedef AbcPOUMM<Tree, Storage> MyType;
   typedef TraversalSpecification<Tree> BaseType;
   typedef Tree TreeType;
   typedef PostOrderTraversal<MyType> AlgorithmType;
   typedef vec ParameterType;
   typedef NumericTraitData<typename TreeType::NodeType> DataType;
   typedef vec StateType;
+  typedef std::vector<Storage> StorageVec;
+  typedef typename ValueTypeOf<Storage>::Type Value;
+  typedef std::vector<Value> ValueVec;
 
-  double x0, alpha, theta, sigma2, sigmae2;
+  Value x0, alpha, theta, sigma2, sigmae2, lnsigmae2;
   vec x;
-  vec a, b, c;
+  StorageVec a, b;
+  ValueVec c;
+  // sum_a(a, i, num_tips) and sum_b(b, i, num_tips) accumulate a and b of the
+  // children of internal node i in PruneNode.
+  ChildSums<Storage, Value> sum_a, sum_b;
+
+  // Cache of the branch-specific quantities depending only on alpha and the
+  // branch lengths, recalculated in SetParameter only when alpha changes:
+  // etalpha[i] = exp(t[i]*alpha) and fe2talpha[i] = alpha / (1 - exp(2*t[i]*alpha))
+  // (-0.5 / t[i] for alpha = 0), where t[i] is the length of the branch
+  // leading to node i.
+  double alpha_cached;
+  ValueVec etalpha, fe2talpha;
 
   AbcPOUMM(TreeType const& tree, DataType const& input_data):
     BaseType(tree) {
@@ -48,23 +73,62 @@ public:
       throw std::invalid_argument(oss.str());
     } else {
 
-      uvec ordNodes = this->ref_tree_.OrderNodes(input_data.names_);
-      this->x = At(input_data.x_, ordNodes);
-      this->a = vec(this->ref_tree_.num_nodes());
-      this->b = vec(this->ref_tree_.num_nodes());
-      this->c = vec(this->ref_tree_.num_nodes());
+      this->x.resize(this->ref_tree_.num_tips());
+      input_data.CopyValuesInTipOrder(this->ref_tree_, this->x);
+      this->a = StorageVec(this->ref_tree_.num_nodes());
+      this->b = StorageVec(this->ref_tree_.num_nodes());
+      this->c = ValueVec(this->ref_tree_.num_nodes());
+      this->sum_a.Resize(this->ref_tree_.num_tips(), this->ref_tree_.num_nodes());
+      this->sum_b.Resize(this->ref_tree_.num_tips(), this->ref_tree_.num_nodes());
+
+      this->alpha_cached = std::numeric_limits<double>::quiet_NaN();
+      this->etalpha = ValueVec(this->ref_tree_.num_nodes() - 1);
+      this->fe2talpha = ValueVec(this->ref_tree_.num_nodes() - 1);
     }
   };
 
+  // Recalculate etalpha and fe2talpha for the current value of alpha.
+  void UpdateCache() {
+    uint num_branches = this->ref_tree_.num_nodes() - 1;
+    _PRAGMA_OMP_SIMD
+    for(uint i = 0; i < num_branches; i++) {
+      etalpha[i] = this->ref_tree_.LengthOfBranch(i) * alpha;
+    }
+    ExpVec(&etalpha[0], &etalpha[0], num_branches);
+    if(alpha != 0) {
+      _PRAGMA_OMP_SIMD
+      for(uint i = 0; i < num_branches; i++) {
+        fe2talpha[i] = alpha / (1 - etalpha[i] * etalpha[i]);
+      }
+    } else {
+      // limit for alpha -> 0; the terms in alpha are needed for the
+      // derivatives with respect to alpha when Value is a dual number.
+      _PRAGMA_OMP_SIMD
+      for(uint i = 0; i < num_branches; i++) {
+        double t = this->ref_tree_.LengthOfBranch(i);
+        fe2talpha[i] = -0.5 / t + alpha * (0.5 - alpha * t / 6);
+      }
+    }
+  }
+
   StateType StateAtRoot() const {
-    vec res(1);
-    double x0_theta = this->x0-this->theta;
-    res[0] = a[this->ref_tree_.num_nodes() - 1] * (x0_theta) * (x0_theta) + 
-      b[this->ref_tree_.num_nodes() - 1] * x0_theta + 
-      c[this->ref_tree_.num_nodes() - 1];
+    vec res;
+    Value x0_theta = this->x0-this->theta;
+    uint i_root = this->ref_tree_.num_nodes() - 1;
+    uint num_tips = this->ref_tree_.num_tips();
+    Value ll = sum_a(a, i_root, num_tips) * (x0_theta) * (x0_theta) + 
+      sum_b(b, i_root, num_tips) * x0_theta + 
+      c[i_root];
+    AppendValue(res, ll);
     return res;
   };
 
+  // Replace the trait values at the tips, keeping the tree and all other
+  // per-node quantities.
+  void SetData(DataType const& input_data) {
+    input_data.CopyValuesInTipOrder(this->ref_tree_, this->x);
+  }
+
   void SetParameter(ParameterType const& par) {
     if(par.size() != 5) {
       throw std::invalid_argument(
@@ -74,47 +138,60 @@ public:
     if(par[1] < 0 || par[3] < 0 || par[4] < 0) {
       throw std::logic_error("The parameters alpha, sigma and sigmae should be non-negative.");
     }
-    this->x0 = par[0];
-    this->alpha = par[1];
-    this->theta = par[2];
-    this->sigma2 = par[3];
-    this->sigmae2 = par[4];
+    this->x0 = Variable<Value>::Create(par[0], 0);
+    this->alpha = Variable<Value>::Create(par[1], 1);
+    this->theta = Variable<Value>::Create(par[2], 2);
+    this->sigma2 = Variable<Value>::Create(par[3], 3);
+    this->sigmae2 = Variable<Value>::Create(par[4], 4);
+    this->lnsigmae2 = log(sigmae2);
+    if(par[1] != alpha_cached) {
+      UpdateCache();
+      alpha_cached = par[1];
+    }
   }
 
   inline void InitNode(uint i) {
     if(i < this->ref_tree_.num_tips()) {
-      double z1 = x[i] - theta;
+      Value z1 = x[i] - theta;
+      Value bi = z1 / sigmae2;
       a[i] = -0.5 / sigmae2;
-      b[i] = z1 / sigmae2;
-      c[i] = -0.5 * (M_LN_2PI  + z1 * b[i] + log(sigmae2));
+      b[i] = bi;
+      c[i] = -0.5 * (M_LN_2PI  + z1 * bi + lnsigmae2);
     } else {
-      a[i] = b[i] = c[i] = 0;
+      uint num_tips = this->ref_tree_.num_tips();
+      sum_a(a, i, num_tips) = 0;
+      sum_b(b, i, num_tips) = 0;
+      c[i] = 0;
     }
   }
 
   inline void VisitNode(uint i) {
 
-    double t = this->ref_tree_.LengthOfBranch(i);
-    double talpha = t * alpha;
-    double etalpha = exp(talpha);
-    double e2talpha = etalpha * etalpha;
-    double fe2talpha;
-    if(alpha != 0) {
-      fe2talpha = alpha / (1 - e2talpha);
+    Value talpha = this->ref_tree_.LengthOfBranch(i) * alpha;
+    Value etalpha = this->etalpha[i];
+    Value e2talpha = etalpha * etalpha;
+    Value fe2talpha = this->fe2talpha[i];
+    Value ai, bi;
+    if(i < this->ref_tree_.num_tips()) {
+      ai = a[i];
+      bi = b[i];
     } else {
-      fe2talpha = -0.5 / t;
+      uint num_tips = this->ref_tree_.num_tips();
+      ai = sum_a(a, i, num_tips);
+      bi = sum_b(b, i, num_tips);
     }
-    double gutalphasigma2 = e2talpha + (a[i] * sigma2) / fe2talpha;
+    Value gutalphasigma2 = e2talpha + (ai * sigma2) / fe2talpha;
 
-    c[i] = -0.5 * log(gutalphasigma2) - 0.25 * sigma2 * b[i] * b[i] /
-      (fe2talpha - alpha + a[i] * sigma2) + talpha + c[i];
-    b[i] = (etalpha * b[i]) / gutalphasigma2;
-    a[i] /= gutalphasigma2;
+    c[i] = -0.5 * log(gutalphasigma2) - 0.25 * sigma2 * bi * bi /
+      (fe2talpha - alpha + ai * sigma2) + talpha + c[i];
+    b[i] = (etalpha * bi) / gutalphasigma2;
+    a[i] = ai / gutalphasigma2;
   }
 
   inline void PruneNode(uint i, uint i_parent) {
-    a[i_parent] += a[i];
-    b[i_parent] += b[i];
+    uint num_tips = this->ref_tree_.num_tips();
+    sum_a(a, i_parent, num_tips) += Value(a[i]);
+    sum_b(b, i_parent, num_tips) += Value(b[i]);
     c[i_parent] += c[i];
   }
 
@@ -0,0 +1,156 @@
+/*
+ *  CompositeSpec.h
+ *  SPLITT
+ *
+ * Copyright 2018 Venelin Mitov
+ *
+ * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+ * Lineage Traversal of Trees.
+ *
+ * SPLITT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SPLITT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SPLITT.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * @author Venelin Mitov
+ */
+
+#ifndef CompositeSpec_H_
+#define CompositeSpec_H_
+
+#include "./SPLITT.h"
+#include <tuple>
+#include <type_traits>
+
+using namespace SPLITT;
+
+namespace ThreePointUsingSPLITT {
+
+// A traversal specification bundling several model specifications on the
+// same tree and data, e.g. ThreePointPMM, ThreePointPOUMM and AbcPOUMM for
+// model selection. Each of InitNode, VisitNode and PruneNode calls the
+// corresponding method of all models, so that a single traversal evaluates
+// all models: the tree is read and the nodes are scheduled once instead of
+// once per model.
+//
+// The parameter is a vector with one parameter vector for each model, in
+// the order of Specs. The state at the root is the concatenation of the
+// states at the root of the models, e.g. one log-likelihood for each model.
+// All models must have the same TreeType and DataType, and vec as StateType.
+template<class Tree, class... Specs>
+class CompositeSpec: public TraversalSpecification<Tree> {
+
+public:
+  typedef CompositeSpec<Tree, Specs...> MyType;
+  typedef TraversalSpecification<Tree> BaseType;
+  typedef Tree TreeType;
+  typedef PostOrderTraversal<MyType> AlgorithmType;
+  typedef std::tuple<Specs...> ModelsType;
+  typedef typename std::tuple_element<0, ModelsType>::type::DataType DataType;
+  typedef std::vector<vec> ParameterType;
+  typedef vec StateType;
+
+  static const uint num_models = sizeof...(Specs);
+
+  CompositeSpec(TreeType const& tree, DataType const& input_data):
+    BaseType(tree), models_(Specs(tree, input_data)...) {}
+
+  // The k-th model.
+  template<uint k>
+  typename std::tuple_element<k, ModelsType>::type & model() {
+    return std::get<k>(models_);
+  }
+
+  void SetData(DataType const& input_data) {
+    ForEachModel(models_, SetDataOp{input_data});
+  }
+
+  void SetParameter(ParameterType const& par) {
+    if(par.size() != num_models) {
+      throw std::invalid_argument("ERR:01601:SPLITT:CompositeSpec.h:SetParameter:: The par should contain one parameter vector for each model.");
+    }
+    ForEachModel(models_, SetParameterOp{par});
+  }
+
+  inline void InitNode(uint i) {
+    ForEachModel(models_, InitNodeOp{i});
+  }
+
+  inline void VisitNode(uint i) {
+    ForEachModel(models_, VisitNodeOp{i});
+  }
+
+  inline void PruneNode(uint i, uint i_parent) {
+    ForEachModel(models_, PruneNodeOp{i, i_parent});
+  }
+
+  StateType StateAtRoot() const {
+    StateType res;
+    ForEachModel(models_, StateAtRootOp{res});
+    return res;
+  }
+
+protected:
+  ModelsType models_;
+
+  // Call op(model, k) for the models k, k + 1, ... in order.
+  template<uint k = 0, class Models, class Op>
+  static inline typename std::enable_if<(k < num_models)>::type
+  ForEachModel(Models& models, Op const& op) {
+    op(std::get<k>(models), k);
+    ForEachModel<k + 1>(models, op);
+  }
+  template<uint k = 0, class Models, class Op>
+  static inline typename std::enable_if<(k == num_models)>::type
+  ForEachModel(Models&, Op const&) {}
+
+  struct SetDataOp {
+    DataType const& input_data;
+    template<class Spec> void operator()(Spec& spec, uint) const {
+      spec.SetData(input_data);
+    }
+  };
+  struct SetParameterOp {
+    ParameterType const& par;
+    template<class Spec> void operator()(Spec& spec, uint k) const {
+      spec.SetParameter(par[k]);
+    }
+  };
+  struct InitNodeOp {
+    uint i;
+    template<class Spec> void operator()(Spec& spec, uint) const {
+      spec.InitNode(i);
+    }
+  };
+  struct VisitNodeOp {
+    uint i;
+    template<class Spec> void operator()(Spec& spec, uint) const {
+      spec.VisitNode(i);
+    }
+  };
+  struct PruneNodeOp {
+    uint i, i_parent;
+    template<class Spec> void operator()(Spec& spec, uint) const {
+      spec.PruneNode(i, i_parent);
+    }
+  };
+  struct StateAtRootOp {
+    StateType& res;
+    template<class Spec> void operator()(Spec const& spec, uint) const {
+      StateType state = spec.StateAtRoot();
+      res.insert(res.end(), state.begin(), state.end());
+    }
+  };
+};
+
+}
+#endif // CompositeSpec_H_
@@ -0,0 +1,293 @@
+/*
+ *  DualNumber.h
+ *  SPLITT
+ *
+ * Copyright 2018 Venelin Mitov
+ *
+ * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+ * Lineage Traversal of Trees.
+ *
+ * SPLITT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SPLITT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SPLITT.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * @author Venelin Mitov
+ */
+#ifndef ThreePointUsingSPLITT_DualNumber_H_
+#define ThreePointUsingSPLITT_DualNumber_H_
+
+#include "./SPLITT.h"
+#include <cmath>
+#include <type_traits>
+#include <vector>
+
+using namespace SPLITT;
+
+namespace ThreePointUsingSPLITT {
+
+// make the overloads for double visible next to the ones for DualNumber.
+using std::exp;
+using std::log;
+
+// A dual number carrying a value and D derivative lanes for forward-mode
+// automatic differentiation. Using a DualNumber<D> as the Storage type of a
+// spec (e.g. ThreePointPOUMM<Tree, DualNumber<5>>) propagates the
+// derivatives with respect to the first D parameters through a single
+// traversal. The loops over the lanes are vectorised with '#pragma omp simd'.
+//
+// The lane type T can itself be a DualNumber, e.g.
+// DualNumber<5, DualNumber<5>> carries second derivatives (forward over
+// forward).
+template<uint D, class T = double>
+class DualNumber {
+public:
+  typedef T LaneType;
+  static const uint NUM_LANES = D;
+
+  // value
+  T v;
+  // derivative lanes
+  T d[D];
+
+  DualNumber(): v(0) {
+    _PRAGMA_OMP_SIMD
+    for(uint k = 0; k < D; k++) d[k] = T(0);
+  }
+
+  // a constant, i.e. all derivatives are 0.
+  DualNumber(double value): v(value) {
+    _PRAGMA_OMP_SIMD
+    for(uint k = 0; k < D; k++) d[k] = T(0);
+  }
+
+  DualNumber& operator+=(DualNumber const& o) {
+    v += o.v;
+    _PRAGMA_OMP_SIMD
+    for(uint k = 0; k < D; k++) d[k] += o.d[k];
+    return *this;
+  }
+
+  DualNumber& operator-=(DualNumber const& o) {
+    v -= o.v;
+    _PRAGMA_OMP_SIMD
+    for(uint k = 0; k < D; k++) d[k] -= o.d[k];
+    return *this;
+  }
+
+  DualNumber& operator*=(DualNumber const& o) {
+    _PRAGMA_OMP_SIMD
+    for(uint k = 0; k < D; k++) d[k] = d[k] * o.v + v * o.d[k];
+    v *= o.v;
+    return *this;
+  }
+
+  DualNumber& operator/=(DualNumber const& o) {
+    T inv = T(1) / o.v;
+    v *= inv;
+    _PRAGMA_OMP_SIMD
+    for(uint k = 0; k < D; k++) d[k] = (d[k] - v * o.d[k]) * inv;
+    return *this;
+  }
+
+  DualNumber operator-() const {
+    DualNumber res;
+    res.v = -v;
+    _PRAGMA_OMP_SIMD
+    for(uint k = 0; k < D; k++) res.d[k] = -d[k];
+    return res;
+  }
+
+  // Apply a scalar function with value fv and first derivative dfv at v.
+  DualNumber Chain(T const& fv, T const& dfv) const {
+    DualNumber res;
+    res.v = fv;
+    _PRAGMA_OMP_SIMD
+    for(uint k = 0; k < D; k++) res.d[k] = dfv * d[k];
+    return res;
+  }
+};
+
+template<uint D, class T>
+inline DualNumber<D, T> operator+(DualNumber<D, T> a, DualNumber<D, T> const& b) {
+  return a += b;
+}
+template<uint D, class T>
+inline DualNumber<D, T> operator-(DualNumber<D, T> a, DualNumber<D, T> const& b) {
+  return a -= b;
+}
+template<uint D, class T>
+inline DualNumber<D, T> operator*(DualNumber<D, T> a, DualNumber<D, T> const& b) {
+  return a *= b;
+}
+template<uint D, class T>
+inline DualNumber<D, T> operator/(DualNumber<D, T> a, DualNumber<D, T> const& b) {
+  return a /= b;
+}
+
+// mixed operations with double constants
+template<uint D, class T>
+inline DualNumber<D, T> operator+(DualNumber<D, T> a, double b) {
+  a.v += b;
+  return a;
+}
+template<uint D, class T>
+inline DualNumber<D, T> operator+(double a, DualNumber<D, T> b) {
+  b.v += a;
+  return b;
+}
+template<uint D, class T>
+inline DualNumber<D, T> operator-(DualNumber<D, T> a, double b) {
+  a.v -= b;
+  return a;
+}
+template<uint D, class T>
+inline DualNumber<D, T> operator-(double a, DualNumber<D, T> const& b) {
+  DualNumber<D, T> res = -b;
+  res.v += a;
+  return res;
+}
+template<uint D, class T>
+inline DualNumber<D, T> operator*(DualNumber<D, T> a, double b) {
+  a.v *= b;
+  _PRAGMA_OMP_SIMD
+  for(uint k = 0; k < D; k++) a.d[k] *= b;
+  return a;
+}
+template<uint D, class T>
+inline DualNumber<D, T> operator*(double a, DualNumber<D, T> b) {
+  return b * a;
+}
+template<uint D, class T>
+inline DualNumber<D, T> operator/(DualNumber<D, T> a, double b) {
+  return a * (1.0 / b);
+}
+template<uint D, class T>
+inline DualNumber<D, T> operator/(double a, DualNumber<D, T> const& b) {
+  T inv = T(1) / b.v;
+  return b.Chain(a * inv, -a * inv * inv);
+}
+
+// comparisons use the value only.
+template<uint D, class T>
+inline bool operator==(DualNumber<D, T> const& a, double b) { return a.v == b; }
+template<uint D, class T>
+inline bool operator!=(DualNumber<D, T> const& a, double b) { return a.v != b; }
+template<uint D, class T>
+inline bool operator<(DualNumber<D, T> const& a, double b) { return a.v < b; }
+template<uint D, class T>
+inline bool operator>(DualNumber<D, T> const& a, double b) { return a.v > b; }
+
+template<uint D, class T>
+inline DualNumber<D, T> exp(DualNumber<D, T> const& a) {
+  T e = exp(a.v);
+  return a.Chain(e, e);
+}
+template<uint D, class T>
+inline DualNumber<D, T> log(DualNumber<D, T> const& a) {
+  return a.Chain(log(a.v), T(1) / a.v);
+}
+
+// y[i] = exp(x[i]) for i in 0, ..., n-1, the counterpart of ExpVec in
+// VectorMath.h for dual numbers.
+template<uint D, class T>
+inline void ExpVec(DualNumber<D, T> const* x, DualNumber<D, T>* y, uint n) {
+  for(uint i = 0; i < n; i++) y[i] = exp(x[i]);
+}
+
+// The type used for arithmetic on values stored as Storage: double for
+// float and double storage, the DualNumber type itself for dual storage.
+template<class Storage> struct ValueTypeOf {
+  typedef Storage Type;
+};
+template<> struct ValueTypeOf<float> {
+  typedef double Type;
+};
+
+// The sums over the children of the internal nodes of a tree, added up in
+// PruneNode and read in VisitNode. sums(stored, i, num_tips) is the sum for
+// internal node i of a quantity stored per node in the vector stored. When
+// Storage is narrower than Value (float storage), the sums are kept in a
+// side vector of Value indexed by i - num_tips, so that each stored value is
+// rounded to Storage only once. Otherwise, the sum of node i is accumulated
+// in place in stored[i], and nothing is allocated.
+template<class Storage, class Value,
+         bool InPlace = std::is_same<Storage, Value>::value>
+class ChildSums {
+  std::vector<Value> sums_;
+public:
+  void Resize(uint num_tips, uint num_nodes) {
+    sums_ = std::vector<Value>(num_nodes - num_tips, Value(0));
+  }
+  // Make room for one more internal node after a tip has been inserted in the
+  // tree (see OrderedTree::InsertTip).
+  void AddInternalNode() {
+    sums_.push_back(Value(0));
+  }
+  Value& operator()(std::vector<Storage>&, uint i, uint num_tips) {
+    return sums_[i - num_tips];
+  }
+  Value const& operator()(std::vector<Storage> const&, uint i, uint num_tips) const {
+    return sums_[i - num_tips];
+  }
+};
+
+template<class Storage, class Value>
+class ChildSums<Storage, Value, true> {
+public:
+  void Resize(uint, uint) {}
+  void AddInternalNode() {}
+  Value& operator()(std::vector<Storage>& stored, uint i, uint) {
+    return stored[i];
+  }
+  Value const& operator()(std::vector<Storage> const& stored, uint i, uint) const {
+    return stored[i];
+  }
+};
+
+// An independent variable with value v, corresponding to the derivative lane
+// lane. For double, this is v itself; for dual numbers, the derivative in the
+// lane is set to 1 (in all nesting levels), if lane < D.
+template<class T> struct Variable {
+  static T Create(double v, uint /*lane*/) { return T(v); }
+};
+template<uint D, class T> struct Variable<DualNumber<D, T>> {
+  static DualNumber<D, T> Create(double v, uint lane) {
+    DualNumber<D, T> res;
+    res.v = Variable<T>::Create(v, lane);
+    if(lane < D) res.d[lane] = T(1);
+    return res;
+  }
+};
+
+// Append a value to a vector: for double, the value itself; for
+// DualNumber<D>, the value followed by the D first derivatives; for
+// DualNumber<D, DualNumber<D>>, the value, the D first derivatives and the
+// D x D second derivatives in row-major order.
+inline void AppendHighestOrder(vec& res, double x) {
+  res.push_back(x);
+}
+template<uint D, class T>
+inline void AppendHighestOrder(vec& res, DualNumber<D, T> const& x) {
+  for(uint k = 0; k < D; k++) AppendHighestOrder(res, x.d[k]);
+}
+inline void AppendValue(vec& res, double x) {
+  res.push_back(x);
+}
+template<uint D, class T>
+inline void AppendValue(vec& res, DualNumber<D, T> const& x) {
+  AppendValue(res, x.v);
+  for(uint k = 0; k < D; k++) AppendHighestOrder(res, x.d[k]);
+}
+
+}
+#endif // ThreePointUsingSPLITT_DualNumber_H_
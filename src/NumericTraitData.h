@@ -32,12 +32,54 @@ namespace ThreePointUsingSPLITT {
 
 template<class NameType>
 struct NumericTraitData {
-  // use const references to avoid copying of long vectors
-  std::vector<NameType> const& names_;
-  SPLITT::vec const& x_;
+  // use non-owning views to avoid copying of long vectors; these can refer 
+  // to std::vectors or directly to the memory of R vectors.
+  SPLITT::VectorView<NameType> names_;
+  SPLITT::VectorView<double> x_;
   NumericTraitData(
-    std::vector<NameType> const& names,
-    SPLITT::vec const& x): names_(names), x_(x) {}
+    SPLITT::VectorView<NameType> const& names,
+    SPLITT::VectorView<double> const& x): names_(names), x_(x) {}
+
+  // Copy the values into x in the order of the tip ids in tree, without
+  // allocating any memory. x must be of size equal to the number of tips.
+  // If an exception is thrown, x may be partially updated.
+  template<class TreeType>
+  void CopyValuesInTipOrder(TreeType const& tree, SPLITT::vec& x) const {
+    if(x_.size() != tree.num_tips() || names_.size() != x_.size()) {
+      throw std::invalid_argument("ERR:01202:SPLITT:NumericTraitData.h:CopyValuesInTipOrder:: The vector x must be the same length as the number of tips.");
+    }
+    for(SPLITT::uint i = 0; i < x_.size(); ++i) {
+      SPLITT::uint id = tree.FindIdOfNode(names_[i]);
+      if(id >= tree.num_tips()) {
+        std::ostringstream oss;
+        oss<<"ERR:01203:SPLITT:NumericTraitData.h:CopyValuesInTipOrder:: The node "<<
+          names_[i]<<" is not a tip in the tree.";
+        throw std::invalid_argument(oss.str());
+      }
+      x[id] = x_[i];
+    }
+  }
+
+  // The positions of the values in x_ in the order of the tip ids in tree,
+  // i.e. the value of tip i is x_[res[i]].
+  template<class TreeType>
+  SPLITT::uvec PositionsInTipOrder(TreeType const& tree) const {
+    if(x_.size() != tree.num_tips() || names_.size() != x_.size()) {
+      throw std::invalid_argument("ERR:01204:SPLITT:NumericTraitData.h:PositionsInTipOrder:: The vector x must be the same length as the number of tips.");
+    }
+    SPLITT::uvec res(x_.size(), SPLITT::G_NA_UINT);
+    for(SPLITT::uint i = 0; i < x_.size(); ++i) {
+      SPLITT::uint id = tree.FindIdOfNode(names_[i]);
+      if(id >= tree.num_tips() || res[id] != SPLITT::G_NA_UINT) {
+        std::ostringstream oss;
+        oss<<"ERR:01205:SPLITT:NumericTraitData.h:PositionsInTipOrder:: The node "<<
+          names_[i]<<" is not a tip in the tree or has more than one value.";
+        throw std::invalid_argument(oss.str());
+      }
+      res[id] = i;
+    }
+    return res;
+  }
 };
 }
 #endif //NumericTraitData_H_
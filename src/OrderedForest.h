@@ -0,0 +1,168 @@
+/*
+ *  OrderedForest.h
+ *  SPLITT
+ *
+ * Copyright 2018 Venelin Mitov
+ *
+ * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+ * Lineage Traversal of Trees.
+ *
+ * SPLITT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SPLITT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SPLITT.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * @author Venelin Mitov
+ */
+#ifndef ParallelPruning_OrderedForest_H_
+#define ParallelPruning_OrderedForest_H_
+
+#include "./SPLITT.h"
+#include <algorithm>
+#include <unordered_set>
+
+using namespace SPLITT;
+
+// The branches of a forest with a virtual root added: a branch of length 0
+// leads from virtual_root to the root of each component. The components are
+// sorted by their root nodes.
+template<class Node, class Length>
+class ForestBranches {
+protected:
+  std::vector<Node> forest_start_nodes_;
+  std::vector<Node> forest_end_nodes_;
+  std::vector<Length> forest_lengths_;
+  std::vector<Node> component_roots_;
+
+  ForestBranches(
+    VectorView<Node> const& branch_start_nodes,
+    VectorView<Node> const& branch_end_nodes,
+    VectorView<Length> const& branch_lengths,
+    Node const& virtual_root) {
+
+    std::unordered_set<Node> end_nodes(
+        branch_end_nodes.begin(), branch_end_nodes.end());
+    if(end_nodes.count(virtual_root) ||
+       std::find(branch_start_nodes.begin(), branch_start_nodes.end(),
+                 virtual_root) != branch_start_nodes.end()) {
+      std::ostringstream oss;
+      oss<<"ERR:01501:SPLITT:OrderedForest.h:OrderedForest:: The virtual root ("<<
+        virtual_root<<") is a node in the forest.";
+      throw std::invalid_argument(oss.str());
+    }
+    std::unordered_set<Node> roots;
+    for(auto const& node: branch_start_nodes) {
+      if(end_nodes.count(node) == 0 && roots.insert(node).second) {
+        component_roots_.push_back(node);
+      }
+    }
+    std::sort(component_roots_.begin(), component_roots_.end());
+
+    forest_start_nodes_.reserve(branch_start_nodes.size() + component_roots_.size());
+    forest_start_nodes_.assign(branch_start_nodes.begin(), branch_start_nodes.end());
+    forest_start_nodes_.insert(
+      forest_start_nodes_.end(), component_roots_.size(), virtual_root);
+
+    forest_end_nodes_.reserve(forest_start_nodes_.size());
+    forest_end_nodes_.assign(branch_end_nodes.begin(), branch_end_nodes.end());
+    forest_end_nodes_.insert(
+      forest_end_nodes_.end(), component_roots_.begin(), component_roots_.end());
+
+    if(branch_lengths.size() > 0) {
+      forest_lengths_.reserve(forest_start_nodes_.size());
+      forest_lengths_.assign(branch_lengths.begin(), branch_lengths.end());
+      forest_lengths_.insert(
+        forest_lengths_.end(), component_roots_.size(), Length(0));
+    }
+  }
+
+  // Release the branch vectors after the tree has been built from them.
+  void ReleaseBranches() {
+    std::vector<Node>().swap(forest_start_nodes_);
+    std::vector<Node>().swap(forest_end_nodes_);
+    std::vector<Length>().swap(forest_lengths_);
+  }
+};
+
+// A forest of trees, e.g. many small transmission clusters, built from a list
+// of branches with one or more roots. The components are joined in a single
+// OrderedTree by branches of length 0 leading from a virtual root node to the
+// root of each component. Thus, the ordering of the nodes for parallel
+// traversal is shared between all components and a single traversal visits
+// the nodes of all components, the levels of the tree including the nodes at
+// the same depth in every component.
+//
+// A branch of length 0 leaves the quantities at the root of a component
+// unchanged in VisitNode for the models in this package. After a post-order
+// traversal, the state at the root of each component is, therefore,
+// available at its id in the tree (see FindIdOfComponentRoot), while the
+// state at the virtual root combines all components, e.g. the sum of their
+// log-likelihoods, given the same parameters.
+//
+// The virtual root must not be a node in the forest. The default NodeType()
+// (i.e. 0 for integer nodes) does not collide with the 1-based node numbers
+// of a phylo object in R.
+template<class Node, class Length>
+class OrderedForest: private ForestBranches<Node, Length>,
+                     public OrderedTree<Node, Length> {
+public:
+  typedef Node NodeType;
+  typedef Length LengthType;
+
+  OrderedForest(
+    VectorView<NodeType> const& branch_start_nodes,
+    VectorView<NodeType> const& branch_end_nodes,
+    VectorView<LengthType> const& branch_lengths,
+    NodeType const& virtual_root = NodeType()):
+    ForestBranches<Node, Length>(
+        branch_start_nodes, branch_end_nodes, branch_lengths, virtual_root),
+    OrderedTree<Node, Length>(
+        this->forest_start_nodes_, this->forest_end_nodes_,
+        this->forest_lengths_) {
+    this->ReleaseBranches();
+  }
+
+  uint num_components() const {
+    return this->component_roots_.size();
+  }
+
+  // The root nodes of the components, sorted.
+  std::vector<NodeType> const& ComponentRoots() const {
+    return this->component_roots_;
+  }
+
+  uint FindIdOfComponentRoot(uint c) const {
+    return this->FindIdOfNode(this->component_roots_[c]);
+  }
+
+  // The component of each node in the order of the node ids; the element for
+  // the virtual root is num_components(). The ids of the nodes change after
+  // topology edits, so the vector is calculated on each call (linear in the
+  // number of nodes).
+  uvec FindComponentOfNodes() const {
+    uint num_nodes = this->num_nodes();
+    uvec res(num_nodes, num_components());
+    for(uint c = 0; c < num_components(); c++) {
+      res[FindIdOfComponentRoot(c)] = c;
+    }
+    // the parent of a node has a bigger id than the node.
+    for(int i = num_nodes - 2; i >= 0; i--) {
+      uint i_parent = this->FindIdOfParent(i);
+      if(i_parent != num_nodes - 1) {
+        res[i] = res[i_parent];
+      }
+    }
+    return res;
+  }
+};
+
+#endif // ParallelPruning_OrderedForest_H_
@@ -26,6 +26,7 @@
 
 #include <Rcpp.h>
 #include "./AbcPOUMM.h"
+#include "./RcppTraverseTreeMany.h"
     
 // [[Rcpp::plugins("cpp11")]]
 // [[Rcpp::plugins(openmp)]]
@@ -39,17 +40,33 @@ typedef TraversalTask<
 
 
 TraversalTaskAbcPOUMM* CreateTraversalTaskAbcPOUMM(
-    Rcpp::List const& tree, vec const& values) {
+    Rcpp::List const& tree, Rcpp::NumericVector const& values) {
   
+  // The edge matrix, the branch lengths and the trait values are read 
+  // directly from the memory of the R objects, without copying them.
   Rcpp::IntegerMatrix branches = tree["edge"];
-  uvec parents(branches.column(0).begin(), branches.column(0).end());
-  uvec daughters(branches.column(1).begin(), branches.column(1).end());
-  vec t = Rcpp::as<vec>(tree["edge.length"]);
+  uint num_branches = branches.nrow();
+  uint const* edge = reinterpret_cast<uint const*>(branches.begin());
+  VectorView<uint> parents(edge, num_branches);
+  VectorView<uint> daughters(edge + num_branches, num_branches);
+  Rcpp::NumericVector t = tree["edge.length"];
   uint num_tips = Rcpp::as<Rcpp::CharacterVector>(tree["tip.label"]).size();
   uvec tip_names = Seq(uint(1), num_tips);
   
-  typename TraversalTaskAbcPOUMM::DataType data(tip_names, values);
-  return new TraversalTaskAbcPOUMM(parents, daughters, t, data);
+  typename TraversalTaskAbcPOUMM::DataType data(
+      tip_names, VectorView<double>(values.begin(), values.size()));
+  
+  return new TraversalTaskAbcPOUMM(
+      parents, daughters, VectorView<double>(t.begin(), t.size()), data);
+}
+
+// Replace the trait values at the tips, keeping the tree.
+void SetDataTraversalTaskAbcPOUMM(
+    TraversalTaskAbcPOUMM* task, Rcpp::NumericVector const& values) {
+  uvec tip_names = Seq(uint(1), task->tree().num_tips());
+  typename TraversalTaskAbcPOUMM::DataType data(
+      tip_names, VectorView<double>(values.begin(), values.size()));
+  task->SetData(data);
 }
 
 
@@ -88,9 +105,18 @@ RCPP_MODULE(ThreePointUsingSPLITT__TraversalTaskAbcPOUMM) {
   Rcpp::class_<TraversalTaskAbcPOUMM>( "ThreePointUsingSPLITT__TraversalTaskAbcPOUMM" )
   // The <argument-type-list> MUST MATCH the arguments of the factory function 
   // defined above.
-  .factory<Rcpp::List const&, vec const&>( &CreateTraversalTaskAbcPOUMM )
+  .factory<Rcpp::List const&, Rcpp::NumericVector const&>( &CreateTraversalTaskAbcPOUMM )
   // Expose the method that we will use to execute the TraversalTask
   .method( "TraverseTree", &TraversalTaskAbcPOUMM::TraverseTree )
+  // Expose the evaluation for each row of a parameter matrix
+  .method( "TraverseTreeMany", &TraverseTreeMany<TraversalTaskAbcPOUMM> )
+  // Expose the cache of the log-likelihood for the last distinct parameters
+  .property( "CacheCapacity", &TraversalTaskAbcPOUMM::cache_capacity, &TraversalTaskAbcPOUMM::set_cache_capacity )
+  .property( "NumCacheHits", &TraversalTaskAbcPOUMM::num_cache_hits )
+  .property( "NumCacheMisses", &TraversalTaskAbcPOUMM::num_cache_misses )
+  .method( "ClearCache", &TraversalTaskAbcPOUMM::ClearCache )
+  // Expose the replacement of the trait values
+  .method( "SetData", &SetDataTraversalTaskAbcPOUMM )
   // Expose the algorithm property
   .property( "algorithm", &TraversalTaskAbcPOUMM::algorithm )
   ;
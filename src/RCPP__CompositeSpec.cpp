@@ -0,0 +1,93 @@
+/**
+  *  RCPP__CompositeSpec.cpp
+  *  SPLITT
+  *
+  * Copyright 2017 Venelin Mitov
+  *
+  * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+  * Lineage Traversal of Trees.
+  *
+  * SPLITT is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU Lesser General Public License as
+  * published by the Free Software Foundation, either version 3 of
+  * the License, or (at your option) any later version.
+  *
+  * SPLITT is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with SPLITT.  If not, see
+  * <http://www.gnu.org/licenses/>.
+  *
+  * @author Venelin Mitov
+  */
+
+#include <Rcpp.h>
+#include "./ThreePointPOUMM.h"
+#include "./ThreePointPMM.h"
+#include "./AbcPOUMM.h"
+#include "./CompositeSpec.h"
+
+// [[Rcpp::plugins("cpp11")]]
+// [[Rcpp::plugins(openmp)]]
+
+using namespace SPLITT;
+using namespace ThreePointUsingSPLITT;
+
+// The PMM, the POUMM and the POUMM calculated by the AbcPOUMM
+// specification, evaluated in a single traversal for model selection.
+typedef TraversalTask<
+  CompositeSpec<OrderedTree<uint, double>,
+                ThreePointPMM<OrderedTree<uint, double> >,
+                ThreePointPOUMM<OrderedTree<uint, double> >,
+                AbcPOUMM<OrderedTree<uint, double> > > > TraversalTaskModelSelection;
+
+
+TraversalTaskModelSelection* CreateTraversalTaskModelSelection(
+    Rcpp::List const& tree, Rcpp::NumericVector const& values) {
+
+  // The edge matrix, the branch lengths and the trait values are read
+  // directly from the memory of the R objects, without copying them.
+  Rcpp::IntegerMatrix branches = tree["edge"];
+  uint num_branches = branches.nrow();
+  uint const* edge = reinterpret_cast<uint const*>(branches.begin());
+  VectorView<uint> parents(edge, num_branches);
+  VectorView<uint> daughters(edge + num_branches, num_branches);
+  Rcpp::NumericVector t = tree["edge.length"];
+  uint num_tips = Rcpp::as<Rcpp::CharacterVector>(tree["tip.label"]).size();
+  uvec tip_names = Seq(uint(1), num_tips);
+
+  typename TraversalTaskModelSelection::DataType data(
+      tip_names, VectorView<double>(values.begin(), values.size()));
+
+  return new TraversalTaskModelSelection(
+      parents, daughters, VectorView<double>(t.begin(), t.size()), data);
+}
+
+// Replace the trait values at the tips, keeping the tree.
+void SetDataTraversalTaskModelSelection(
+    TraversalTaskModelSelection* task, Rcpp::NumericVector const& values) {
+  uvec tip_names = Seq(uint(1), task->tree().num_tips());
+  typename TraversalTaskModelSelection::DataType data(
+      tip_names, VectorView<double>(values.begin(), values.size()));
+  task->SetData(data);
+}
+
+RCPP_MODULE(ThreePointUsingSPLITT__CompositeSpec) {
+
+  Rcpp::class_<TraversalTaskModelSelection>( "ThreePointUsingSPLITT__TraversalTaskModelSelection" )
+  // The <argument-type-list> MUST MATCH the arguments of the factory function
+  // defined above.
+  .factory<Rcpp::List const&, Rcpp::NumericVector const&>( &CreateTraversalTaskModelSelection )
+  // The parameter is a list of three numeric vectors, one for each model;
+  // the result is a vector of three log-likelihoods.
+  .method( "TraverseTree", &TraversalTaskModelSelection::TraverseTree )
+  .property( "CacheCapacity", &TraversalTaskModelSelection::cache_capacity, &TraversalTaskModelSelection::set_cache_capacity )
+  .property( "NumCacheHits", &TraversalTaskModelSelection::num_cache_hits )
+  .property( "NumCacheMisses", &TraversalTaskModelSelection::num_cache_misses )
+  .method( "ClearCache", &TraversalTaskModelSelection::ClearCache )
+  .method( "SetData", &SetDataTraversalTaskModelSelection )
+  ;
+}
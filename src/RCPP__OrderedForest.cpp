@@ -0,0 +1,129 @@
+/**
+  *  RCPP__OrderedForest.cpp
+  *  SPLITT
+  *
+  * Copyright 2017 Venelin Mitov
+  *
+  * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+  * Lineage Traversal of Trees.
+  *
+  * SPLITT is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU Lesser General Public License as
+  * published by the Free Software Foundation, either version 3 of
+  * the License, or (at your option) any later version.
+  *
+  * SPLITT is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with SPLITT.  If not, see
+  * <http://www.gnu.org/licenses/>.
+  *
+  * @author Venelin Mitov
+  */
+
+#include <Rcpp.h>
+#include "./ThreePointPOUMM.h"
+#include "./ThreePointPMM.h"
+#include "./OrderedForest.h"
+#include "./RcppTraverseTreeMany.h"
+
+// [[Rcpp::plugins("cpp11")]]
+// [[Rcpp::plugins(openmp)]]
+
+using namespace SPLITT;
+using namespace ThreePointUsingSPLITT;
+
+typedef TraversalTask<
+  ThreePointPOUMM<OrderedForest<uint, double> > > TraversalTaskThreePointPOUMMForest;
+typedef TraversalTask<
+  ThreePointPMM<OrderedForest<uint, double> > > TraversalTaskThreePointPMMForest;
+
+
+template<class Task>
+Task* CreateTraversalTaskForest(
+    Rcpp::List const& forest, Rcpp::NumericVector const& values) {
+
+  // The edge matrix may have several roots. The node 0, which is not used
+  // by the 1-based node numbers in R, is the virtual root joining them.
+  Rcpp::IntegerMatrix branches = forest["edge"];
+  uint num_branches = branches.nrow();
+  uint const* edge = reinterpret_cast<uint const*>(branches.begin());
+  VectorView<uint> parents(edge, num_branches);
+  VectorView<uint> daughters(edge + num_branches, num_branches);
+  Rcpp::NumericVector t = forest["edge.length"];
+  uint num_tips = Rcpp::as<Rcpp::CharacterVector>(forest["tip.label"]).size();
+  uvec tip_names = Seq(uint(1), num_tips);
+
+  typename Task::DataType data(
+      tip_names, VectorView<double>(values.begin(), values.size()));
+
+  return new Task(
+      parents, daughters, VectorView<double>(t.begin(), t.size()), data);
+}
+
+// Traverse the forest once, returning the state at the root of each
+// component: a vector with one element per component or a matrix with one
+// row per component.
+template<class Task>
+SEXP TraverseForest(
+    Task* task, typename Task::ParameterType const& par, uint mode) {
+  task->TraverseTree(par, mode);
+  std::vector<typename Task::StateType> states =
+    task->spec().StatesAtComponentRoots();
+
+  uint num_components = states.size();
+  uint num_values = num_components > 0 ? states[0].size() : 1;
+  Rcpp::NumericMatrix res(num_components, num_values);
+  for(uint c = 0; c < num_components; c++) {
+    for(uint k = 0; k < num_values; k++) {
+      res(c, k) = states[c][k];
+    }
+  }
+  if(num_values == 1) {
+    return Rcpp::NumericVector(res.begin(), res.end());
+  } else {
+    return res;
+  }
+}
+
+template<class Task>
+uint NumComponents(Task* task) {
+  return task->tree().num_components();
+}
+
+template<class Task>
+uvec ComponentRoots(Task* task) {
+  return task->tree().ComponentRoots();
+}
+
+RCPP_MODULE(ThreePointUsingSPLITT__OrderedForest) {
+
+  // The <argument-type-list> of each factory MUST MATCH the arguments of the
+  // factory function.
+  Rcpp::class_<TraversalTaskThreePointPOUMMForest>( "ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMForest" )
+  .factory<Rcpp::List const&, Rcpp::NumericVector const&>(
+      &CreateTraversalTaskForest<TraversalTaskThreePointPOUMMForest> )
+  // the sum of the log-likelihoods of the components
+  .method( "TraverseTree", &TraversalTaskThreePointPOUMMForest::TraverseTree )
+  .method( "TraverseTreeMany", &TraverseTreeMany<TraversalTaskThreePointPOUMMForest> )
+  // the log-likelihood of each component
+  .method( "TraverseForest", &TraverseForest<TraversalTaskThreePointPOUMMForest> )
+  .property( "NumComponents", &NumComponents<TraversalTaskThreePointPOUMMForest> )
+  .property( "ComponentRoots", &ComponentRoots<TraversalTaskThreePointPOUMMForest> )
+  ;
+
+  Rcpp::class_<TraversalTaskThreePointPMMForest>( "ThreePointUsingSPLITT__TraversalTaskThreePointPMMForest" )
+  .factory<Rcpp::List const&, Rcpp::NumericVector const&>(
+      &CreateTraversalTaskForest<TraversalTaskThreePointPMMForest> )
+  // the sum of the log-likelihoods of the components
+  .method( "TraverseTree", &TraversalTaskThreePointPMMForest::TraverseTree )
+  .method( "TraverseTreeMany", &TraverseTreeMany<TraversalTaskThreePointPMMForest> )
+  // the log-likelihood of each component
+  .method( "TraverseForest", &TraverseForest<TraversalTaskThreePointPMMForest> )
+  .property( "NumComponents", &NumComponents<TraversalTaskThreePointPMMForest> )
+  .property( "ComponentRoots", &ComponentRoots<TraversalTaskThreePointPMMForest> )
+  ;
+}
@@ -0,0 +1,117 @@
+/**
+  *  RCPP__SharedTree.cpp
+  *  SPLITT
+  *
+  * Copyright 2017 Venelin Mitov
+  *
+  * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+  * Lineage Traversal of Trees.
+  *
+  * SPLITT is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU Lesser General Public License as
+  * published by the Free Software Foundation, either version 3 of
+  * the License, or (at your option) any later version.
+  *
+  * SPLITT is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with SPLITT.  If not, see
+  * <http://www.gnu.org/licenses/>.
+  *
+  * @author Venelin Mitov
+  */
+
+#include <Rcpp.h>
+#include "./ThreePointPOUMM.h"
+#include "./ThreePointPMM.h"
+#include "./AbcPOUMM.h"
+#include "./TraversalTaskSharedTree.h"
+#include "./RcppTraverseTreeMany.h"
+
+// [[Rcpp::plugins("cpp11")]]
+// [[Rcpp::plugins(openmp)]]
+
+using namespace SPLITT;
+using namespace ThreePointUsingSPLITT;
+
+typedef SharedTree<OrderedTree<uint, double> > SharedOrderedTree;
+
+typedef TraversalTaskSharedTree<
+  ThreePointPOUMM<OrderedTree<uint, double> > > TraversalTaskThreePointPOUMMSharedTree;
+typedef TraversalTaskSharedTree<
+  ThreePointPMM<OrderedTree<uint, double> > > TraversalTaskThreePointPMMSharedTree;
+typedef TraversalTaskSharedTree<
+  AbcPOUMM<OrderedTree<uint, double> > > TraversalTaskAbcPOUMMSharedTree;
+
+
+SharedOrderedTree* CreateSharedOrderedTree(Rcpp::List const& tree) {
+
+  // The edge matrix and the branch lengths are read directly from the 
+  // memory of the R objects, without copying them.
+  Rcpp::IntegerMatrix branches = tree["edge"];
+  uint num_branches = branches.nrow();
+  uint const* edge = reinterpret_cast<uint const*>(branches.begin());
+  VectorView<uint> parents(edge, num_branches);
+  VectorView<uint> daughters(edge + num_branches, num_branches);
+  Rcpp::NumericVector t = tree["edge.length"];
+
+  return new SharedOrderedTree(
+      parents, daughters, VectorView<double>(t.begin(), t.size()));
+}
+
+// The tasks are created on an object of the exposed class SharedOrderedTree
+// passed from R.
+RCPP_EXPOSED_CLASS_NODECL(SharedOrderedTree)
+
+template<class Task>
+Task* CreateTraversalTaskSharedTree(
+    SharedOrderedTree const& tree, Rcpp::NumericVector const& values) {
+
+  uvec tip_names = Seq(uint(1), tree.num_tips());
+  typename Task::DataType data(
+      tip_names, VectorView<double>(values.begin(), values.size()));
+
+  return new Task(tree, data);
+}
+
+RCPP_MODULE(ThreePointUsingSPLITT__SharedTree) {
+
+  // The tree handle, built once from a phylo object
+  Rcpp::class_<SharedOrderedTree>( "ThreePointUsingSPLITT__SharedTree" )
+  .factory<Rcpp::List const&>( &CreateSharedOrderedTree )
+  .property( "NumTips", &SharedOrderedTree::num_tips )
+  .property( "NumNodes", &SharedOrderedTree::num_nodes )
+  // Expose the number of handles and tasks sharing the tree
+  .property( "UseCount", &SharedOrderedTree::use_count )
+  ;
+
+  // The tasks for the different models, sharing a tree handle. The
+  // <argument-type-list> of each factory MUST MATCH the arguments of the
+  // factory function.
+  Rcpp::class_<TraversalTaskThreePointPOUMMSharedTree>( "ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMSharedTree" )
+  .factory<SharedOrderedTree const&, Rcpp::NumericVector const&>(
+      &CreateTraversalTaskSharedTree<TraversalTaskThreePointPOUMMSharedTree> )
+  .method( "TraverseTree", &TraversalTaskThreePointPOUMMSharedTree::TraverseTree )
+  // Expose the evaluation for each row of a parameter matrix
+  .method( "TraverseTreeMany", &TraverseTreeMany<TraversalTaskThreePointPOUMMSharedTree> )
+  ;
+
+  Rcpp::class_<TraversalTaskThreePointPMMSharedTree>( "ThreePointUsingSPLITT__TraversalTaskThreePointPMMSharedTree" )
+  .factory<SharedOrderedTree const&, Rcpp::NumericVector const&>(
+      &CreateTraversalTaskSharedTree<TraversalTaskThreePointPMMSharedTree> )
+  .method( "TraverseTree", &TraversalTaskThreePointPMMSharedTree::TraverseTree )
+  // Expose the evaluation for each row of a parameter matrix
+  .method( "TraverseTreeMany", &TraverseTreeMany<TraversalTaskThreePointPMMSharedTree> )
+  ;
+
+  Rcpp::class_<TraversalTaskAbcPOUMMSharedTree>( "ThreePointUsingSPLITT__TraversalTaskAbcPOUMMSharedTree" )
+  .factory<SharedOrderedTree const&, Rcpp::NumericVector const&>(
+      &CreateTraversalTaskSharedTree<TraversalTaskAbcPOUMMSharedTree> )
+  .method( "TraverseTree", &TraversalTaskAbcPOUMMSharedTree::TraverseTree )
+  // Expose the evaluation for each row of a parameter matrix
+  .method( "TraverseTreeMany", &TraverseTreeMany<TraversalTaskAbcPOUMMSharedTree> )
+  ;
+}
@@ -0,0 +1,121 @@
+/**
+  *  RCPP__ThreePointMMDual.cpp
+  *  SPLITT
+  *
+  * Copyright 2017 Venelin Mitov
+  *
+  * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+  * Lineage Traversal of Trees.
+  *
+  * SPLITT is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU Lesser General Public License as
+  * published by the Free Software Foundation, either version 3 of
+  * the License, or (at your option) any later version.
+  *
+  * SPLITT is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with SPLITT.  If not, see
+  * <http://www.gnu.org/licenses/>.
+  *
+  * @author Venelin Mitov
+  */
+
+#include <Rcpp.h>
+#include "./ThreePointPMM.h"
+#include "./RcppTraverseTreeMany.h"
+    
+// [[Rcpp::plugins("cpp11")]]
+// [[Rcpp::plugins(openmp)]]
+
+using namespace SPLITT;
+using namespace ThreePointUsingSPLITT;
+
+typedef TraversalTask< ThreePointPMM<OrderedTree<uint, double>, DualNumber<3> > > TraversalTaskThreePointPMMDual;
+
+
+TraversalTaskThreePointPMMDual* CreateTraversalTaskThreePointPMMDual(
+    Rcpp::List const& tree, Rcpp::NumericVector const& values) {
+  
+  // The edge matrix, the branch lengths and the trait values are read 
+  // directly from the memory of the R objects, without copying them.
+  Rcpp::IntegerMatrix branches = tree["edge"];
+  uint num_branches = branches.nrow();
+  uint const* edge = reinterpret_cast<uint const*>(branches.begin());
+  VectorView<uint> parents(edge, num_branches);
+  VectorView<uint> daughters(edge + num_branches, num_branches);
+  Rcpp::NumericVector t = tree["edge.length"];
+  uint num_tips = Rcpp::as<Rcpp::CharacterVector>(tree["tip.label"]).size();
+  uvec tip_names = Seq(uint(1), num_tips);
+  
+  typename TraversalTaskThreePointPMMDual::DataType data(
+      tip_names, VectorView<double>(values.begin(), values.size()));
+  
+  return new TraversalTaskThreePointPMMDual(
+      parents, daughters, VectorView<double>(t.begin(), t.size()), data);
+}
+
+// Replace the trait values at the tips, keeping the tree.
+void SetDataTraversalTaskThreePointPMMDual(
+    TraversalTaskThreePointPMMDual* task, Rcpp::NumericVector const& values) {
+  uvec tip_names = Seq(uint(1), task->tree().num_tips());
+  typename TraversalTaskThreePointPMMDual::DataType data(
+      tip_names, VectorView<double>(values.begin(), values.size()));
+  task->SetData(data);
+}
+
+
+// This will enable returning a copy of the `TraversalAlgorithm`-object stored in
+// a `TraversalTaskThreePointPMMDual` object to a R. This will be used in the MiniBenchmark
+// R-function to check things like the OpenMP version used during compilation and
+// the number of OpenMP threads at runtime. 
+RCPP_EXPOSED_CLASS_NODECL(TraversalTaskThreePointPMMDual::AlgorithmType)
+RCPP_MODULE(ThreePointUsingSPLITT__TraversalTaskThreePointPMMDual) {
+  
+  // Expose the properties VersionOPENMP and NumOmpThreads from the base 
+  // TraversalAlgorithm class
+  Rcpp::class_<TraversalTaskThreePointPMMDual::AlgorithmType::ParentType> (
+      "ThreePointUsingSPLITT__ThreePointPMMDual__TraversalAlgorithm"
+    )
+  .property( "VersionOPENMP",
+             &TraversalTaskThreePointPMMDual::AlgorithmType::ParentType::VersionOPENMP )
+  .property( "NumOmpThreads",
+             &TraversalTaskThreePointPMMDual::AlgorithmType::ParentType::NumOmpThreads )
+  ;
+
+  // Expose the TraversalTaskThreePointPMMDual::AlgorithmType specifying that it derives 
+  // from the base TraversalAlgorithm class
+  Rcpp::class_<TraversalTaskThreePointPMMDual::AlgorithmType> (
+      "ThreePointUsingSPLITT__ThreePointPMMDual__AlgorithmType"
+    )
+  .derives<TraversalTaskThreePointPMMDual::AlgorithmType::ParentType>(
+      "ThreePointUsingSPLITT__ThreePointPMMDual__TraversalAlgorithm"
+    )
+  ;
+  
+  // Finally, expose the TraversalTaskThreePointPMMDual class - this is the main class in 
+  // the module, which will be instantiated from R using the factory function
+  // we've just written.
+  Rcpp::class_<TraversalTaskThreePointPMMDual>( "ThreePointUsingSPLITT__TraversalTaskThreePointPMMDual" )
+  // The <argument-type-list> MUST MATCH the arguments of the factory function 
+  // defined above.
+  .factory<Rcpp::List const&, Rcpp::NumericVector const&>( &CreateTraversalTaskThreePointPMMDual )
+  // Expose the method that we will use to execute the TraversalTask
+  .method( "TraverseTree", &TraversalTaskThreePointPMMDual::TraverseTree )
+  // Expose the evaluation for each row of a parameter matrix
+  .method( "TraverseTreeMany", &TraverseTreeMany<TraversalTaskThreePointPMMDual> )
+  // Expose the cache of the log-likelihood for the last distinct parameters
+  .property( "CacheCapacity", &TraversalTaskThreePointPMMDual::cache_capacity, &TraversalTaskThreePointPMMDual::set_cache_capacity )
+  .property( "NumCacheHits", &TraversalTaskThreePointPMMDual::num_cache_hits )
+  .property( "NumCacheMisses", &TraversalTaskThreePointPMMDual::num_cache_misses )
+  .method( "ClearCache", &TraversalTaskThreePointPMMDual::ClearCache )
+  // Expose the replacement of the trait values
+  .method( "SetData", &SetDataTraversalTaskThreePointPMMDual )
+  // Expose the algorithm property
+  .property( "algorithm", &TraversalTaskThreePointPMMDual::algorithm )
+  ;
+}
+
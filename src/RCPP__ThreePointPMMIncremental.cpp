@@ -0,0 +1,122 @@
+/**
+  *  RCPP__ThreePointPMMIncremental.cpp
+  *  SPLITT
+  *
+  * Copyright 2017 Venelin Mitov
+  *
+  * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+  * Lineage Traversal of Trees.
+  *
+  * SPLITT is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU Lesser General Public License as
+  * published by the Free Software Foundation, either version 3 of
+  * the License, or (at your option) any later version.
+  *
+  * SPLITT is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with SPLITT.  If not, see
+  * <http://www.gnu.org/licenses/>.
+  *
+  * @author Venelin Mitov
+  */
+
+#include <Rcpp.h>
+#include "./ThreePointPMM.h"
+#include "./TraversalTaskIncremental.h"
+#include "./RcppTraverseTreeMany.h"
+    
+// [[Rcpp::plugins("cpp11")]]
+// [[Rcpp::plugins(openmp)]]
+
+using namespace SPLITT;
+using namespace ThreePointUsingSPLITT;
+
+typedef TraversalTaskIncremental<
+  ThreePointPMM<OrderedTree<uint, double> > > TraversalTaskThreePointPMMIncremental;
+
+
+
+TraversalTaskThreePointPMMIncremental* CreateTraversalTaskThreePointPMMIncremental(
+    Rcpp::List const& tree, Rcpp::NumericVector const& values) {
+  
+  // The edge matrix, the branch lengths and the trait values are read 
+  // directly from the memory of the R objects, without copying them.
+  Rcpp::IntegerMatrix branches = tree["edge"];
+  uint num_branches = branches.nrow();
+  uint const* edge = reinterpret_cast<uint const*>(branches.begin());
+  VectorView<uint> parents(edge, num_branches);
+  VectorView<uint> daughters(edge + num_branches, num_branches);
+  Rcpp::NumericVector t = tree["edge.length"];
+  uint num_tips = Rcpp::as<Rcpp::CharacterVector>(tree["tip.label"]).size();
+  uvec tip_names = Seq(uint(1), num_tips);
+  
+  typename TraversalTaskThreePointPMMIncremental::DataType data(
+      tip_names, VectorView<double>(values.begin(), values.size()));
+  
+  return new TraversalTaskThreePointPMMIncremental(
+      parents, daughters, VectorView<double>(t.begin(), t.size()), data);
+}
+
+
+// This will enable returning a copy of the `TraversalAlgorithm`-object stored in
+// a `TraversalTaskThreePointPMMIncremental` object to a R. This will be used in the MiniBenchmark
+// R-function to check things like the OpenMP version used during compilation and
+// the number of OpenMP threads at runtime. 
+RCPP_EXPOSED_CLASS_NODECL(TraversalTaskThreePointPMMIncremental::AlgorithmType)
+  
+RCPP_MODULE(ThreePointUsingSPLITT__TraversalTaskThreePointPMMIncremental) {
+  
+  // Expose the properties VersionOPENMP and NumOmpThreads from the base 
+  // TraversalAlgorithm class
+  Rcpp::class_<TraversalTaskThreePointPMMIncremental::AlgorithmType::ParentType> (
+      "ThreePointUsingSPLITT__ThreePointPMMIncremental__TraversalAlgorithm"
+    )
+  .property( "VersionOPENMP",
+             &TraversalTaskThreePointPMMIncremental::AlgorithmType::ParentType::VersionOPENMP )
+  .property( "NumOmpThreads",
+             &TraversalTaskThreePointPMMIncremental::AlgorithmType::ParentType::NumOmpThreads )
+  ;
+
+  // Expose the TraversalTaskThreePointPMMIncremental::AlgorithmType specifying that it derives 
+  // from the base TraversalAlgorithm class
+  Rcpp::class_<TraversalTaskThreePointPMMIncremental::AlgorithmType> (
+      "ThreePointUsingSPLITT__ThreePointPMMIncremental__AlgorithmType"
+    )
+  .derives<TraversalTaskThreePointPMMIncremental::AlgorithmType::ParentType>(
+      "ThreePointUsingSPLITT__ThreePointPMMIncremental__TraversalAlgorithm"
+    )
+  ;
+  
+  // Finally, expose the TraversalTaskThreePointPMMIncremental class - this is the main class in 
+  // the module, which will be instantiated from R using the factory function
+  // we've just written.
+  Rcpp::class_<TraversalTaskThreePointPMMIncremental>( "ThreePointUsingSPLITT__TraversalTaskThreePointPMMIncremental" )
+  // The <argument-type-list> MUST MATCH the arguments of the factory function 
+  // defined above.
+  .factory<Rcpp::List const&, Rcpp::NumericVector const&>( &CreateTraversalTaskThreePointPMMIncremental )
+  // Expose the method that we will use to execute the TraversalTask
+  .method( "TraverseTree", &TraversalTaskThreePointPMMIncremental::TraverseTree )
+  // Expose the evaluation for each row of a parameter matrix
+  .method( "TraverseTreeMany", &TraverseTreeMany<TraversalTaskThreePointPMMIncremental> )
+  // Expose the method setting the lengths of selected branches
+  .method( "SetBranchLengths", &TraversalTaskThreePointPMMIncremental::SetBranchLengths )
+  // Expose the method setting the trait values at selected tips
+  .method( "SetTipValues", &TraversalTaskThreePointPMMIncremental::SetTipValues )
+  // Expose the topology edits
+  .method( "SubtreePruneAndRegraft", &TraversalTaskThreePointPMMIncremental::SubtreePruneAndRegraft )
+  .method( "NearestNeighborInterchange", &TraversalTaskThreePointPMMIncremental::NearestNeighborInterchange )
+  // Expose the insertion of new tips
+  .method( "InsertTip", &TraversalTaskThreePointPMMIncremental::InsertTip )
+  // Expose the number of nodes visited during the last call to TraverseTree
+  .property( "NumNodesVisited", &TraversalTaskThreePointPMMIncremental::num_nodes_visited )
+  // Expose the fraction of dirty nodes above which the tree is fully traversed
+  .property( "MaxFractionDirty", &TraversalTaskThreePointPMMIncremental::max_fraction_dirty, &TraversalTaskThreePointPMMIncremental::set_max_fraction_dirty )
+  // Expose the algorithm property
+  .property( "algorithm", &TraversalTaskThreePointPMMIncremental::algorithm )
+  ;
+}
+
@@ -26,6 +26,7 @@
 
 #include <Rcpp.h>
 #include "./ThreePointPOUMM.h"
+#include "./RcppTraverseTreeMany.h"
     
 // [[Rcpp::plugins("cpp11")]]
 // [[Rcpp::plugins(openmp)]]
@@ -39,18 +40,33 @@ typedef TraversalTask<
 
 
 TraversalTaskThreePointPOUMM* CreateTraversalTaskThreePointPOUMM(
-    Rcpp::List const& tree, vec const& values) {
+    Rcpp::List const& tree, Rcpp::NumericVector const& values) {
   
+  // The edge matrix, the branch lengths and the trait values are read 
+  // directly from the memory of the R objects, without copying them.
   Rcpp::IntegerMatrix branches = tree["edge"];
-  uvec parents(branches.column(0).begin(), branches.column(0).end());
-  uvec daughters(branches.column(1).begin(), branches.column(1).end());
-  vec t = Rcpp::as<vec>(tree["edge.length"]);
+  uint num_branches = branches.nrow();
+  uint const* edge = reinterpret_cast<uint const*>(branches.begin());
+  VectorView<uint> parents(edge, num_branches);
+  VectorView<uint> daughters(edge + num_branches, num_branches);
+  Rcpp::NumericVector t = tree["edge.length"];
   uint num_tips = Rcpp::as<Rcpp::CharacterVector>(tree["tip.label"]).size();
   uvec tip_names = Seq(uint(1), num_tips);
   
-  typename TraversalTaskThreePointPOUMM::DataType data(tip_names, values);
+  typename TraversalTaskThreePointPOUMM::DataType data(
+      tip_names, VectorView<double>(values.begin(), values.size()));
   
-  return new TraversalTaskThreePointPOUMM(parents, daughters, t, data);
+  return new TraversalTaskThreePointPOUMM(
+      parents, daughters, VectorView<double>(t.begin(), t.size()), data);
+}
+
+// Replace the trait values at the tips, keeping the tree.
+void SetDataTraversalTaskThreePointPOUMM(
+    TraversalTaskThreePointPOUMM* task, Rcpp::NumericVector const& values) {
+  uvec tip_names = Seq(uint(1), task->tree().num_tips());
+  typename TraversalTaskThreePointPOUMM::DataType data(
+      tip_names, VectorView<double>(values.begin(), values.size()));
+  task->SetData(data);
 }
 
 
@@ -89,9 +105,18 @@ RCPP_MODULE(ThreePointUsingSPLITT__TraversalTaskThreePointPOUMM) {
   Rcpp::class_<TraversalTaskThreePointPOUMM>( "ThreePointUsingSPLITT__TraversalTaskThreePointPOUMM" )
   // The <argument-type-list> MUST MATCH the arguments of the factory function 
   // defined above.
-  .factory<Rcpp::List const&, vec const&>( &CreateTraversalTaskThreePointPOUMM )
+  .factory<Rcpp::List const&, Rcpp::NumericVector const&>( &CreateTraversalTaskThreePointPOUMM )
   // Expose the method that we will use to execute the TraversalTask
   .method( "TraverseTree", &TraversalTaskThreePointPOUMM::TraverseTree )
+  // Expose the evaluation for each row of a parameter matrix
+  .method( "TraverseTreeMany", &TraverseTreeMany<TraversalTaskThreePointPOUMM> )
+  // Expose the cache of the log-likelihood for the last distinct parameters
+  .property( "CacheCapacity", &TraversalTaskThreePointPOUMM::cache_capacity, &TraversalTaskThreePointPOUMM::set_cache_capacity )
+  .property( "NumCacheHits", &TraversalTaskThreePointPOUMM::num_cache_hits )
+  .property( "NumCacheMisses", &TraversalTaskThreePointPOUMM::num_cache_misses )
+  .method( "ClearCache", &TraversalTaskThreePointPOUMM::ClearCache )
+  // Expose the replacement of the trait values
+  .method( "SetData", &SetDataTraversalTaskThreePointPOUMM )
   // Expose the algorithm property
   .property( "algorithm", &TraversalTaskThreePointPOUMM::algorithm )
   ;
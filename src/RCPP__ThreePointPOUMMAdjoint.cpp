@@ -0,0 +1,111 @@
+/**
+  *  RCPP__ThreePointPOUMMAdjoint.cpp
+  *  SPLITT
+  *
+  * Copyright 2017 Venelin Mitov
+  *
+  * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+  * Lineage Traversal of Trees.
+  *
+  * SPLITT is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU Lesser General Public License as
+  * published by the Free Software Foundation, either version 3 of
+  * the License, or (at your option) any later version.
+  *
+  * SPLITT is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with SPLITT.  If not, see
+  * <http://www.gnu.org/licenses/>.
+  *
+  * @author Venelin Mitov
+  */
+
+#include <Rcpp.h>
+#include "./ThreePointPOUMM.h"
+#include "./ThreePointUnivariateAdjoint.h"
+#include "./RcppTraverseTreeMany.h"
+    
+// [[Rcpp::plugins("cpp11")]]
+// [[Rcpp::plugins(openmp)]]
+
+using namespace SPLITT;
+using namespace ThreePointUsingSPLITT;
+
+typedef TraversalTaskAdjoint<
+  ThreePointPOUMM<OrderedTree<uint, double> > > TraversalTaskThreePointPOUMMAdjoint;
+
+
+
+TraversalTaskThreePointPOUMMAdjoint* CreateTraversalTaskThreePointPOUMMAdjoint(
+    Rcpp::List const& tree, Rcpp::NumericVector const& values) {
+  
+  // The edge matrix, the branch lengths and the trait values are read 
+  // directly from the memory of the R objects, without copying them.
+  Rcpp::IntegerMatrix branches = tree["edge"];
+  uint num_branches = branches.nrow();
+  uint const* edge = reinterpret_cast<uint const*>(branches.begin());
+  VectorView<uint> parents(edge, num_branches);
+  VectorView<uint> daughters(edge + num_branches, num_branches);
+  Rcpp::NumericVector t = tree["edge.length"];
+  uint num_tips = Rcpp::as<Rcpp::CharacterVector>(tree["tip.label"]).size();
+  uvec tip_names = Seq(uint(1), num_tips);
+  
+  typename TraversalTaskThreePointPOUMMAdjoint::DataType data(
+      tip_names, VectorView<double>(values.begin(), values.size()));
+  
+  return new TraversalTaskThreePointPOUMMAdjoint(
+      parents, daughters, VectorView<double>(t.begin(), t.size()), data);
+}
+
+
+// This will enable returning a copy of the `TraversalAlgorithm`-object stored in
+// a `TraversalTaskThreePointPOUMMAdjoint` object to a R. This will be used in the MiniBenchmark
+// R-function to check things like the OpenMP version used during compilation and
+// the number of OpenMP threads at runtime. 
+RCPP_EXPOSED_CLASS_NODECL(TraversalTaskThreePointPOUMMAdjoint::AlgorithmType)
+  
+RCPP_MODULE(ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMAdjoint) {
+  
+  // Expose the properties VersionOPENMP and NumOmpThreads from the base 
+  // TraversalAlgorithm class
+  Rcpp::class_<TraversalTaskThreePointPOUMMAdjoint::AlgorithmType::ParentType> (
+      "ThreePointUsingSPLITT__ThreePointPOUMMAdjoint__TraversalAlgorithm"
+    )
+  .property( "VersionOPENMP",
+             &TraversalTaskThreePointPOUMMAdjoint::AlgorithmType::ParentType::VersionOPENMP )
+  .property( "NumOmpThreads",
+             &TraversalTaskThreePointPOUMMAdjoint::AlgorithmType::ParentType::NumOmpThreads )
+  ;
+
+  // Expose the TraversalTaskThreePointPOUMMAdjoint::AlgorithmType specifying that it derives 
+  // from the base TraversalAlgorithm class
+  Rcpp::class_<TraversalTaskThreePointPOUMMAdjoint::AlgorithmType> (
+      "ThreePointUsingSPLITT__ThreePointPOUMMAdjoint__AlgorithmType"
+    )
+  .derives<TraversalTaskThreePointPOUMMAdjoint::AlgorithmType::ParentType>(
+      "ThreePointUsingSPLITT__ThreePointPOUMMAdjoint__TraversalAlgorithm"
+    )
+  ;
+  
+  // Finally, expose the TraversalTaskThreePointPOUMMAdjoint class - this is the main class in 
+  // the module, which will be instantiated from R using the factory function
+  // we've just written.
+  Rcpp::class_<TraversalTaskThreePointPOUMMAdjoint>( "ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMAdjoint" )
+  // The <argument-type-list> MUST MATCH the arguments of the factory function 
+  // defined above.
+  .factory<Rcpp::List const&, Rcpp::NumericVector const&>( &CreateTraversalTaskThreePointPOUMMAdjoint )
+  // Expose the method that we will use to execute the TraversalTask
+  .method( "TraverseTree", &TraversalTaskThreePointPOUMMAdjoint::TraverseTree )
+  // Expose the evaluation for each row of a parameter matrix
+  .method( "TraverseTreeMany", &TraverseTreeMany<TraversalTaskThreePointPOUMMAdjoint> )
+  // Expose the method calculating the gradient with respect to the branch lengths
+  .method( "BranchLengthGradient", &TraversalTaskThreePointPOUMMAdjoint::BranchLengthGradient )
+  // Expose the algorithm property
+  .property( "algorithm", &TraversalTaskThreePointPOUMMAdjoint::algorithm )
+  ;
+}
+
@@ -0,0 +1,122 @@
+/**
+  *  RCPP__ThreePointPOUMMIncremental.cpp
+  *  SPLITT
+  *
+  * Copyright 2017 Venelin Mitov
+  *
+  * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+  * Lineage Traversal of Trees.
+  *
+  * SPLITT is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU Lesser General Public License as
+  * published by the Free Software Foundation, either version 3 of
+  * the License, or (at your option) any later version.
+  *
+  * SPLITT is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with SPLITT.  If not, see
+  * <http://www.gnu.org/licenses/>.
+  *
+  * @author Venelin Mitov
+  */
+
+#include <Rcpp.h>
+#include "./ThreePointPOUMM.h"
+#include "./TraversalTaskIncremental.h"
+#include "./RcppTraverseTreeMany.h"
+    
+// [[Rcpp::plugins("cpp11")]]
+// [[Rcpp::plugins(openmp)]]
+
+using namespace SPLITT;
+using namespace ThreePointUsingSPLITT;
+
+typedef TraversalTaskIncremental<
+  ThreePointPOUMM<OrderedTree<uint, double> > > TraversalTaskThreePointPOUMMIncremental;
+
+
+
+TraversalTaskThreePointPOUMMIncremental* CreateTraversalTaskThreePointPOUMMIncremental(
+    Rcpp::List const& tree, Rcpp::NumericVector const& values) {
+  
+  // The edge matrix, the branch lengths and the trait values are read 
+  // directly from the memory of the R objects, without copying them.
+  Rcpp::IntegerMatrix branches = tree["edge"];
+  uint num_branches = branches.nrow();
+  uint const* edge = reinterpret_cast<uint const*>(branches.begin());
+  VectorView<uint> parents(edge, num_branches);
+  VectorView<uint> daughters(edge + num_branches, num_branches);
+  Rcpp::NumericVector t = tree["edge.length"];
+  uint num_tips = Rcpp::as<Rcpp::CharacterVector>(tree["tip.label"]).size();
+  uvec tip_names = Seq(uint(1), num_tips);
+  
+  typename TraversalTaskThreePointPOUMMIncremental::DataType data(
+      tip_names, VectorView<double>(values.begin(), values.size()));
+  
+  return new TraversalTaskThreePointPOUMMIncremental(
+      parents, daughters, VectorView<double>(t.begin(), t.size()), data);
+}
+
+
+// This will enable returning a copy of the `TraversalAlgorithm`-object stored in
+// a `TraversalTaskThreePointPOUMMIncremental` object to a R. This will be used in the MiniBenchmark
+// R-function to check things like the OpenMP version used during compilation and
+// the number of OpenMP threads at runtime. 
+RCPP_EXPOSED_CLASS_NODECL(TraversalTaskThreePointPOUMMIncremental::AlgorithmType)
+  
+RCPP_MODULE(ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMIncremental) {
+  
+  // Expose the properties VersionOPENMP and NumOmpThreads from the base 
+  // TraversalAlgorithm class
+  Rcpp::class_<TraversalTaskThreePointPOUMMIncremental::AlgorithmType::ParentType> (
+      "ThreePointUsingSPLITT__ThreePointPOUMMIncremental__TraversalAlgorithm"
+    )
+  .property( "VersionOPENMP",
+             &TraversalTaskThreePointPOUMMIncremental::AlgorithmType::ParentType::VersionOPENMP )
+  .property( "NumOmpThreads",
+             &TraversalTaskThreePointPOUMMIncremental::AlgorithmType::ParentType::NumOmpThreads )
+  ;
+
+  // Expose the TraversalTaskThreePointPOUMMIncremental::AlgorithmType specifying that it derives 
+  // from the base TraversalAlgorithm class
+  Rcpp::class_<TraversalTaskThreePointPOUMMIncremental::AlgorithmType> (
+      "ThreePointUsingSPLITT__ThreePointPOUMMIncremental__AlgorithmType"
+    )
+  .derives<TraversalTaskThreePointPOUMMIncremental::AlgorithmType::ParentType>(
+      "ThreePointUsingSPLITT__ThreePointPOUMMIncremental__TraversalAlgorithm"
+    )
+  ;
+  
+  // Finally, expose the TraversalTaskThreePointPOUMMIncremental class - this is the main class in 
+  // the module, which will be instantiated from R using the factory function
+  // we've just written.
+  Rcpp::class_<TraversalTaskThreePointPOUMMIncremental>( "ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMIncremental" )
+  // The <argument-type-list> MUST MATCH the arguments of the factory function 
+  // defined above.
+  .factory<Rcpp::List const&, Rcpp::NumericVector const&>( &CreateTraversalTaskThreePointPOUMMIncremental )
+  // Expose the method that we will use to execute the TraversalTask
+  .method( "TraverseTree", &TraversalTaskThreePointPOUMMIncremental::TraverseTree )
+  // Expose the evaluation for each row of a parameter matrix
+  .method( "TraverseTreeMany", &TraverseTreeMany<TraversalTaskThreePointPOUMMIncremental> )
+  // Expose the method setting the lengths of selected branches
+  .method( "SetBranchLengths", &TraversalTaskThreePointPOUMMIncremental::SetBranchLengths )
+  // Expose the method setting the trait values at selected tips
+  .method( "SetTipValues", &TraversalTaskThreePointPOUMMIncremental::SetTipValues )
+  // Expose the topology edits
+  .method( "SubtreePruneAndRegraft", &TraversalTaskThreePointPOUMMIncremental::SubtreePruneAndRegraft )
+  .method( "NearestNeighborInterchange", &TraversalTaskThreePointPOUMMIncremental::NearestNeighborInterchange )
+  // Expose the insertion of new tips
+  .method( "InsertTip", &TraversalTaskThreePointPOUMMIncremental::InsertTip )
+  // Expose the number of nodes visited during the last call to TraverseTree
+  .property( "NumNodesVisited", &TraversalTaskThreePointPOUMMIncremental::num_nodes_visited )
+  // Expose the fraction of dirty nodes above which the tree is fully traversed
+  .property( "MaxFractionDirty", &TraversalTaskThreePointPOUMMIncremental::max_fraction_dirty, &TraversalTaskThreePointPOUMMIncremental::set_max_fraction_dirty )
+  // Expose the algorithm property
+  .property( "algorithm", &TraversalTaskThreePointPOUMMIncremental::algorithm )
+  ;
+}
+
@@ -0,0 +1,98 @@
+/**
+  *  RCPP__TraversalTaskPool.cpp
+  *  SPLITT
+  *
+  * Copyright 2017 Venelin Mitov
+  *
+  * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+  * Lineage Traversal of Trees.
+  *
+  * SPLITT is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU Lesser General Public License as
+  * published by the Free Software Foundation, either version 3 of
+  * the License, or (at your option) any later version.
+  *
+  * SPLITT is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with SPLITT.  If not, see
+  * <http://www.gnu.org/licenses/>.
+  *
+  * @author Venelin Mitov
+  */
+
+#include <Rcpp.h>
+#include "./ThreePointPOUMM.h"
+#include "./ThreePointPMM.h"
+#include "./TraversalTaskPool.h"
+#include "./RcppTraverseTreeMany.h"
+
+// [[Rcpp::plugins("cpp11")]]
+// [[Rcpp::plugins(openmp)]]
+
+using namespace SPLITT;
+using namespace ThreePointUsingSPLITT;
+
+typedef TraversalTaskPool<
+  ThreePointPOUMM<OrderedTree<uint, double> > > TraversalTaskThreePointPOUMMPool;
+typedef TraversalTaskPool<
+  ThreePointPMM<OrderedTree<uint, double> > > TraversalTaskThreePointPMMPool;
+
+
+template<class Task>
+Task* CreateTraversalTaskPool(
+    Rcpp::List const& tree, Rcpp::NumericVector const& values, 
+    uint num_workspaces) {
+  
+  // The edge matrix, the branch lengths and the trait values are read 
+  // directly from the memory of the R objects, without copying them.
+  Rcpp::IntegerMatrix branches = tree["edge"];
+  uint num_branches = branches.nrow();
+  uint const* edge = reinterpret_cast<uint const*>(branches.begin());
+  VectorView<uint> parents(edge, num_branches);
+  VectorView<uint> daughters(edge + num_branches, num_branches);
+  Rcpp::NumericVector t = tree["edge.length"];
+  uint num_tips = Rcpp::as<Rcpp::CharacterVector>(tree["tip.label"]).size();
+  uvec tip_names = Seq(uint(1), num_tips);
+  
+  typename Task::DataType data(
+      tip_names, VectorView<double>(values.begin(), values.size()));
+  
+  return new Task(
+      parents, daughters, VectorView<double>(t.begin(), t.size()), data,
+      num_workspaces);
+}
+
+RCPP_MODULE(ThreePointUsingSPLITT__TraversalTaskPool) {
+  
+  // The <argument-type-list> of each factory MUST MATCH the arguments of the
+  // factory function.
+  Rcpp::class_<TraversalTaskThreePointPOUMMPool>( "ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMPool" )
+  .factory<Rcpp::List const&, Rcpp::NumericVector const&, uint>( 
+      &CreateTraversalTaskPool<TraversalTaskThreePointPOUMMPool> )
+  .method( "TraverseTree", &TraversalTaskThreePointPOUMMPool::TraverseTree )
+  // Expose the parallel evaluation for each row of a parameter matrix
+  .method( "TraverseTreeMany", &TraverseTreeManyParallel<TraversalTaskThreePointPOUMMPool> )
+  .property( "NumWorkspaces", &TraversalTaskThreePointPOUMMPool::num_workspaces )
+  .property( "MinTipsPerThread", &TraversalTaskThreePointPOUMMPool::min_tips_per_thread,
+             &TraversalTaskThreePointPOUMMPool::set_min_tips_per_thread )
+  .property( "NumOuterThreads", &NumOuterThreads<TraversalTaskThreePointPOUMMPool> )
+  .property( "NumInnerThreads", &NumInnerThreads<TraversalTaskThreePointPOUMMPool> )
+  ;
+  
+  Rcpp::class_<TraversalTaskThreePointPMMPool>( "ThreePointUsingSPLITT__TraversalTaskThreePointPMMPool" )
+  .factory<Rcpp::List const&, Rcpp::NumericVector const&, uint>( 
+      &CreateTraversalTaskPool<TraversalTaskThreePointPMMPool> )
+  .method( "TraverseTree", &TraversalTaskThreePointPMMPool::TraverseTree )
+  // Expose the parallel evaluation for each row of a parameter matrix
+  .method( "TraverseTreeMany", &TraverseTreeManyParallel<TraversalTaskThreePointPMMPool> )
+  .property( "NumWorkspaces", &TraversalTaskThreePointPMMPool::num_workspaces )
+  .property( "MinTipsPerThread", &TraversalTaskThreePointPMMPool::min_tips_per_thread,
+             &TraversalTaskThreePointPMMPool::set_min_tips_per_thread )
+  .property( "NumOuterThreads", &NumOuterThreads<TraversalTaskThreePointPMMPool> )
+  .property( "NumInnerThreads", &NumInnerThreads<TraversalTaskThreePointPMMPool> )
+  ;
+}
@@ -0,0 +1,124 @@
+/**
+  *  RCPP__TraversalTaskTreeSet.cpp
+  *  SPLITT
+  *
+  * Copyright 2017 Venelin Mitov
+  *
+  * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+  * Lineage Traversal of Trees.
+  *
+  * SPLITT is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU Lesser General Public License as
+  * published by the Free Software Foundation, either version 3 of
+  * the License, or (at your option) any later version.
+  *
+  * SPLITT is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with SPLITT.  If not, see
+  * <http://www.gnu.org/licenses/>.
+  *
+  * @author Venelin Mitov
+  */
+
+#include <Rcpp.h>
+#include "./ThreePointPOUMM.h"
+#include "./ThreePointPMM.h"
+#include "./TraversalTaskTreeSet.h"
+#include "./RcppTraverseTreeMany.h"
+
+// [[Rcpp::plugins("cpp11")]]
+// [[Rcpp::plugins(openmp)]]
+
+using namespace SPLITT;
+using namespace ThreePointUsingSPLITT;
+
+typedef TraversalTaskTreeSet<
+  ThreePointPOUMM<OrderedTree<uint, double> > > TraversalTaskThreePointPOUMMTreeSet;
+typedef TraversalTaskTreeSet<
+  ThreePointPMM<OrderedTree<uint, double> > > TraversalTaskThreePointPMMTreeSet;
+
+
+// Add a tree with the trait values in values; tip_nodes[i] is the number of
+// the tip with value values[i] in tree$edge. The edge matrix, the branch
+// lengths, the tip numbers and the trait values are read directly from the
+// memory of the R objects, without copying them.
+template<class TreeSet>
+uint AddTree(
+    TreeSet* set, Rcpp::List const& tree, Rcpp::IntegerVector const& tip_nodes,
+    Rcpp::NumericVector const& values) {
+
+  Rcpp::IntegerMatrix branches = tree["edge"];
+  uint num_branches = branches.nrow();
+  uint const* edge = reinterpret_cast<uint const*>(branches.begin());
+  VectorView<uint> parents(edge, num_branches);
+  VectorView<uint> daughters(edge + num_branches, num_branches);
+  Rcpp::NumericVector t = tree["edge.length"];
+
+  typename TreeSet::DataType data(
+      VectorView<uint>(
+        reinterpret_cast<uint const*>(tip_nodes.begin()), tip_nodes.size()),
+      VectorView<double>(values.begin(), values.size()));
+
+  return set->AddTree(
+    parents, daughters, VectorView<double>(t.begin(), t.size()), data);
+}
+
+// The state at the root of each tree: a vector with one element per tree or
+// a matrix with one row per tree.
+template<class TreeSet>
+SEXP TraverseTrees(
+    TreeSet* set, typename TreeSet::ParameterType const& par, uint mode) {
+  std::vector<typename TreeSet::StateType> states =
+    set->TraverseTrees(par, mode);
+
+  uint num_trees = states.size();
+  uint num_values = num_trees > 0 ? states[0].size() : 1;
+  Rcpp::NumericMatrix res(num_trees, num_values);
+  for(uint i = 0; i < num_trees; i++) {
+    for(uint k = 0; k < num_values; k++) {
+      res(i, k) = states[i][k];
+    }
+  }
+  if(num_values == 1) {
+    return Rcpp::NumericVector(res.begin(), res.end());
+  } else {
+    return res;
+  }
+}
+
+RCPP_MODULE(ThreePointUsingSPLITT__TraversalTaskTreeSet) {
+
+  Rcpp::class_<TraversalTaskThreePointPOUMMTreeSet>( "ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMTreeSet" )
+  .constructor()
+  .method( "AddTree", &AddTree<TraversalTaskThreePointPOUMMTreeSet> )
+  .method( "TraverseTrees", &TraverseTrees<TraversalTaskThreePointPOUMMTreeSet> )
+  .property( "NumTrees", &TraversalTaskThreePointPOUMMTreeSet::num_trees )
+  .property( "MinTipsPerThread", &TraversalTaskThreePointPOUMMTreeSet::min_tips_per_thread,
+             &TraversalTaskThreePointPOUMMTreeSet::set_min_tips_per_thread )
+  .property( "NumOuterThreads", &NumOuterThreads<TraversalTaskThreePointPOUMMTreeSet> )
+  .property( "NumInnerThreads", &NumInnerThreads<TraversalTaskThreePointPOUMMTreeSet> )
+  .property( "UseCladeCache", &TraversalTaskThreePointPOUMMTreeSet::use_clade_cache,
+             &TraversalTaskThreePointPOUMMTreeSet::set_use_clade_cache )
+  .property( "NumCachedClades", &TraversalTaskThreePointPOUMMTreeSet::num_cached_clades )
+  .property( "NumNodesVisited", &TraversalTaskThreePointPOUMMTreeSet::num_nodes_visited )
+  ;
+
+  Rcpp::class_<TraversalTaskThreePointPMMTreeSet>( "ThreePointUsingSPLITT__TraversalTaskThreePointPMMTreeSet" )
+  .constructor()
+  .method( "AddTree", &AddTree<TraversalTaskThreePointPMMTreeSet> )
+  .method( "TraverseTrees", &TraverseTrees<TraversalTaskThreePointPMMTreeSet> )
+  .property( "NumTrees", &TraversalTaskThreePointPMMTreeSet::num_trees )
+  .property( "MinTipsPerThread", &TraversalTaskThreePointPMMTreeSet::min_tips_per_thread,
+             &TraversalTaskThreePointPMMTreeSet::set_min_tips_per_thread )
+  .property( "NumOuterThreads", &NumOuterThreads<TraversalTaskThreePointPMMTreeSet> )
+  .property( "NumInnerThreads", &NumInnerThreads<TraversalTaskThreePointPMMTreeSet> )
+  .property( "UseCladeCache", &TraversalTaskThreePointPMMTreeSet::use_clade_cache,
+             &TraversalTaskThreePointPMMTreeSet::set_use_clade_cache )
+  .property( "NumCachedClades", &TraversalTaskThreePointPMMTreeSet::num_cached_clades )
+  .property( "NumNodesVisited", &TraversalTaskThreePointPMMTreeSet::num_nodes_visited )
+  ;
+}
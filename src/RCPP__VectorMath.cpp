@@ -0,0 +1,82 @@
+/**
+  *  RCPP__VectorMath.cpp
+  *  SPLITT
+  *
+  * Copyright 2018 Venelin Mitov
+  *
+  * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+  * Lineage Traversal of Trees.
+  *
+  * SPLITT is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU Lesser General Public License as
+  * published by the Free Software Foundation, either version 3 of
+  * the License, or (at your option) any later version.
+  *
+  * SPLITT is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with SPLITT.  If not, see
+  * <http://www.gnu.org/licenses/>.
+  *
+  * @author Venelin Mitov
+  */
+
+#include <Rcpp.h>
+#include "./VectorMath.h"
+
+// [[Rcpp::plugins("cpp11")]]
+// [[Rcpp::plugins(openmp)]]
+
+using namespace ThreePointUsingSPLITT;
+
+//' Vectorised exp and log functions used in the POUMM likelihood calculation
+//' @description These functions call the SIMD kernels defined in the header
+//' VectorMath.h. They are exported for testing and benchmarking of these 
+//' kernels against the R functions exp and log.
+//' @param x a numeric vector.
+//' @param inPlace logical indicating if the kernel should write the result
+//' over a copy of x (i.e. with the same array as argument and result), as
+//' done in the likelihood calculation. Default: FALSE.
+//' @param scalar logical indicating if ExpVecCpp, LogVecCpp and the 
+//' likelihood calculations should call the C math library functions exp and
+//' log instead of the SIMD kernels.
+//' @return ExpVecCpp and LogVecCpp: a numeric vector of the same length as x;
+//' UseScalarLibmCpp: the previous value of the switch.
+//' @name VectorMath
+//' @aliases ExpVecCpp LogVecCpp UseScalarLibmCpp
+//' @seealso \code{\link{BenchmarkVectorMath}}
+// [[Rcpp::export]]
+std::vector<double> ExpVecCpp(std::vector<double> const& x, bool inPlace = false) {
+  std::vector<double> y;
+  if(inPlace) {
+    y = x;
+    if(y.size() > 0) ExpVec(&y[0], &y[0], y.size());
+  } else {
+    ExpVec(x, y);
+  }
+  return y;
+}
+
+//' @rdname VectorMath
+// [[Rcpp::export]]
+std::vector<double> LogVecCpp(std::vector<double> const& x, bool inPlace = false) {
+  std::vector<double> y;
+  if(inPlace) {
+    y = x;
+    if(y.size() > 0) LogVec(&y[0], &y[0], y.size());
+  } else {
+    LogVec(x, y);
+  }
+  return y;
+}
+
+//' @rdname VectorMath
+// [[Rcpp::export]]
+bool UseScalarLibmCpp(bool scalar) {
+  bool previous = VectorMath::UseScalarLibm();
+  VectorMath::UseScalarLibm() = scalar;
+  return previous;
+}
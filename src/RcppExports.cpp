@@ -5,15 +5,87 @@
 
 using namespace Rcpp;
 
+// ExpVecCpp
+std::vector<double> ExpVecCpp(std::vector<double> const& x, bool inPlace);
+RcppExport SEXP _ThreePointUsingSPLITT_ExpVecCpp(SEXP xSEXP, SEXP inPlaceSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::vector<double> const& >::type x(xSEXP);
+    Rcpp::traits::input_parameter< bool >::type inPlace(inPlaceSEXP);
+    rcpp_result_gen = Rcpp::wrap(ExpVecCpp(x, inPlace));
+    return rcpp_result_gen;
+END_RCPP
+}
+// LogVecCpp
+std::vector<double> LogVecCpp(std::vector<double> const& x, bool inPlace);
+RcppExport SEXP _ThreePointUsingSPLITT_LogVecCpp(SEXP xSEXP, SEXP inPlaceSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::vector<double> const& >::type x(xSEXP);
+    Rcpp::traits::input_parameter< bool >::type inPlace(inPlaceSEXP);
+    rcpp_result_gen = Rcpp::wrap(LogVecCpp(x, inPlace));
+    return rcpp_result_gen;
+END_RCPP
+}
+// UseScalarLibmCpp
+bool UseScalarLibmCpp(bool scalar);
+RcppExport SEXP _ThreePointUsingSPLITT_UseScalarLibmCpp(SEXP scalarSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< bool >::type scalar(scalarSEXP);
+    rcpp_result_gen = Rcpp::wrap(UseScalarLibmCpp(scalar));
+    return rcpp_result_gen;
+END_RCPP
+}
 
 RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskAbcPOUMM();
 RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPMM();
 RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMM();
+RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMProfile();
+RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPMMProfile();
+RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMFloat();
+RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskAbcPOUMMFloat();
+RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMDual();
+RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskAbcPOUMMDual();
+RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPMMDual();
+RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMAdjoint();
+RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPMMAdjoint();
+RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMHessian();
+RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMIncremental();
+RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPMMIncremental();
+RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__SharedTree();
+RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskPool();
+RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__OrderedForest();
+RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskTreeSet();
+RcppExport SEXP _rcpp_module_boot_ThreePointUsingSPLITT__CompositeSpec();
 
 static const R_CallMethodDef CallEntries[] = {
+    {"_ThreePointUsingSPLITT_ExpVecCpp", (DL_FUNC) &_ThreePointUsingSPLITT_ExpVecCpp, 2},
+    {"_ThreePointUsingSPLITT_LogVecCpp", (DL_FUNC) &_ThreePointUsingSPLITT_LogVecCpp, 2},
+    {"_ThreePointUsingSPLITT_UseScalarLibmCpp", (DL_FUNC) &_ThreePointUsingSPLITT_UseScalarLibmCpp, 1},
     {"_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskAbcPOUMM", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskAbcPOUMM, 0},
     {"_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPMM", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPMM, 0},
     {"_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMM", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMM, 0},
+    {"_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMProfile", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMProfile, 0},
+    {"_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPMMProfile", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPMMProfile, 0},
+    {"_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMFloat", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMFloat, 0},
+    {"_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskAbcPOUMMFloat", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskAbcPOUMMFloat, 0},
+    {"_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMDual", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMDual, 0},
+    {"_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskAbcPOUMMDual", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskAbcPOUMMDual, 0},
+    {"_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPMMDual", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPMMDual, 0},
+    {"_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMAdjoint", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMAdjoint, 0},
+    {"_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPMMAdjoint", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPMMAdjoint, 0},
+    {"_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMHessian", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMHessian, 0},
+    {"_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMIncremental", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPOUMMIncremental, 0},
+    {"_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPMMIncremental", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskThreePointPMMIncremental, 0},
+    {"_rcpp_module_boot_ThreePointUsingSPLITT__SharedTree", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__SharedTree, 0},
+    {"_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskPool", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskPool, 0},
+    {"_rcpp_module_boot_ThreePointUsingSPLITT__OrderedForest", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__OrderedForest, 0},
+    {"_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskTreeSet", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__TraversalTaskTreeSet, 0},
+    {"_rcpp_module_boot_ThreePointUsingSPLITT__CompositeSpec", (DL_FUNC) &_rcpp_module_boot_ThreePointUsingSPLITT__CompositeSpec, 0},
     {NULL, NULL, 0}
 };
 
@@ -0,0 +1,119 @@
+/*
+ *  RcppTraverseTreeMany.h
+ *  ThreePointUsingSPLITT
+ *
+ * Copyright 2018 Venelin Mitov
+ *
+ * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+ * Lineage Traversal of Trees.
+ *
+ * SPLITT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SPLITT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SPLITT.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * @author Venelin Mitov
+ */
+#ifndef ThreePointUsingSPLITT_RcppTraverseTreeMany_H_
+#define ThreePointUsingSPLITT_RcppTraverseTreeMany_H_
+
+#include <Rcpp.h>
+#include "./SPLITT.h"
+
+// Call task->TraverseTree(par, mode) for each row par of the matrix pars in a
+// single call from R. The parameter vector is copied into a buffer reused for
+// all rows. Returns a numeric vector if the state at the root has a single
+// element (e.g. the log-likelihood); otherwise, a matrix with the state at 
+// the root for each row of pars in its rows. Exposed as the method 
+// TraverseTreeMany of the Rcpp modules.
+template<class Task>
+SEXP TraverseTreeMany(Task* task, Rcpp::NumericMatrix const& pars, SPLITT::uint mode) {
+  SPLITT::uint num_pars = pars.nrow();
+  SPLITT::uint num_elements = pars.ncol();
+  
+  typename Task::ParameterType par(num_elements);
+  Rcpp::NumericMatrix res(num_pars, 1);
+  
+  for(SPLITT::uint i = 0; i < num_pars; i++) {
+    for(SPLITT::uint j = 0; j < num_elements; j++) {
+      par[j] = pars(i, j);
+    }
+    typename Task::StateType state = task->TraverseTree(par, mode);
+    if(i == 0 && state.size() != 1) {
+      res = Rcpp::NumericMatrix(num_pars, state.size());
+    } else if(state.size() != SPLITT::uint(res.ncol())) {
+      throw std::logic_error("ERR:01401:SPLITT:RcppTraverseTreeMany.h:TraverseTreeMany:: The states at the root have different sizes.");
+    }
+    for(SPLITT::uint k = 0; k < state.size(); k++) {
+      res(i, k) = state[k];
+    }
+  }
+  
+  if(res.ncol() == 1) {
+    return Rcpp::NumericVector(res.begin(), res.end());
+  } else {
+    return res;
+  }
+}
+
+// As TraverseTreeMany, but passes all rows of pars to the method 
+// task->TraverseTreeMany, which evaluates them in parallel (see 
+// TraversalTaskPool.h). The rows are copied into a vector of parameters 
+// before, and the states are copied into the result after the parallel 
+// evaluation, so that no R object is accessed by the parallel threads.
+template<class Task>
+SEXP TraverseTreeManyParallel(Task* task, Rcpp::NumericMatrix const& pars, SPLITT::uint mode) {
+  SPLITT::uint num_pars = pars.nrow();
+  SPLITT::uint num_elements = pars.ncol();
+  
+  std::vector<typename Task::ParameterType> par_vector(
+      num_pars, typename Task::ParameterType(num_elements));
+  for(SPLITT::uint i = 0; i < num_pars; i++) {
+    for(SPLITT::uint j = 0; j < num_elements; j++) {
+      par_vector[i][j] = pars(i, j);
+    }
+  }
+  
+  std::vector<typename Task::StateType> states = 
+    task->TraverseTreeMany(par_vector, mode);
+  
+  SPLITT::uint num_values = num_pars > 0 ? states[0].size() : 1;
+  Rcpp::NumericMatrix res(num_pars, num_values);
+  for(SPLITT::uint i = 0; i < num_pars; i++) {
+    if(states[i].size() != num_values) {
+      throw std::logic_error("ERR:01402:SPLITT:RcppTraverseTreeMany.h:TraverseTreeManyParallel:: The states at the root have different sizes.");
+    }
+    for(SPLITT::uint k = 0; k < num_values; k++) {
+      res(i, k) = states[i][k];
+    }
+  }
+  
+  if(num_values == 1) {
+    return Rcpp::NumericVector(res.begin(), res.end());
+  } else {
+    return res;
+  }
+}
+
+// The split of the threads between the parameters or trees and the
+// traversals in the last call to TraverseTreeMany or TraverseTrees of a
+// TraversalTaskPool or a TraversalTaskTreeSet (see TraversalTaskBatch.h).
+template<class Task>
+SPLITT::uint NumOuterThreads(Task* task) {
+  return task->plan().num_outer_threads;
+}
+template<class Task>
+SPLITT::uint NumInnerThreads(Task* task) {
+  return task->plan().num_inner_threads;
+}
+
+#endif // ThreePointUsingSPLITT_RcppTraverseTreeMany_H_
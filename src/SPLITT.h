@@ -36,6 +36,7 @@
 #include <numeric>
 #include <chrono>
 #include <unordered_map>
+#include <list>
 #include <mutex>
 #include <condition_variable>
 
@@ -160,6 +161,55 @@ typedef std::vector<double> vec;
 //' @seealso \link{SPLITT}
 typedef std::vector<bool> bvec;
 
+//' @name SPLITT::VectorView
+//' @backref src/SPLITT.h
+//' @title A non-owning read-only view of a contiguous array.
+//' 
+//' @description 
+//' \code{template<class T> class VectorView;}
+//' 
+//' Refers to \code{size} elements of type \code{T} starting at 
+//' \code{data}, which are neither copied nor freed by the view. It is 
+//' implicitly constructible from a 
+//' \href{http://en.cppreference.com/w/cpp/container/vector}{\code{std::vector<T>}}, 
+//' so it can be passed wherever a \code{std::vector<T> const&} was passed 
+//' before. Used to read memory owned by the calling application, e.g. R 
+//' vectors, without copying it. The viewed memory must outlive the view.
+//' 
+//' @family basic types
+//' @seealso \link{SPLITT}
+template<class T>
+class VectorView {
+  T const* data_;
+  std::size_t size_;
+public:
+  typedef T value_type;
+  typedef T const* const_iterator;
+  
+  VectorView(): data_(nullptr), size_(0) {}
+  VectorView(T const* data, std::size_t size): data_(data), size_(size) {}
+  VectorView(std::vector<T> const& v): data_(v.data()), size_(v.size()) {}
+  
+  std::size_t size() const {
+    return size_;
+  }
+  bool empty() const {
+    return size_ == 0;
+  }
+  T const& operator[](std::size_t i) const {
+    return data_[i];
+  }
+  T const* data() const {
+    return data_;
+  }
+  const_iterator begin() const {
+    return data_;
+  }
+  const_iterator end() const {
+    return data_ + size_;
+  }
+};
+
 /*******************************************************************************
  
  Global constants
@@ -535,6 +585,43 @@ public:
 // and to call their TraverseTree method.
 // typedef TraversalTask<TraversalSpecificationImplementation> > MyTraversalTask;
 
+// Check if a value or any element of a (nested) vector of values is NaN. Such
+// a parameter is not stored in the cache of TraversalTask, since NaN != NaN.
+template<class Value>
+inline bool ContainsNaN(Value const& x) {
+  return x != x;
+}
+template<class Value>
+inline bool ContainsNaN(std::vector<Value> const& v) {
+  for(auto const& x: v) {
+    if(ContainsNaN(x)) return true;
+  }
+  return false;
+}
+
+// Hash function for vectors of values, e.g. the parameter vectors used as 
+// keys of the cache in TraversalTask. The elements may be vectors themselves,
+// e.g. one parameter vector for each model of a composite specification.
+struct HashVector {
+  template<class VectorValues>
+  std::size_t operator()(VectorValues const& v) const {
+    std::size_t h = v.size();
+    for(auto const& x: v) {
+      h ^= HashValue(x) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    }
+    return h;
+  }
+private:
+  template<class Value>
+  std::size_t HashValue(Value const& x) const {
+    return std::hash<Value>()(x);
+  }
+  template<class Value>
+  std::size_t HashValue(std::vector<Value> const& x) const {
+    return (*this)(x);
+  }
+};
+
 //' @name SPLITT::TraversalTask
 //' @backref src/SPLITT.h
 //' 
@@ -555,6 +642,9 @@ public:
 //' \item{\link[=SPLITT::TraversalTask::tree]{tree}}{}
 //' \item{\link[=SPLITT::TraversalTask::spec]{spec}}{}
 //' \item{\link[=SPLITT::TraversalTask::algorithm]{algorithm}}{}
+//' \item{\link[=SPLITT::TraversalTask::set_cache_capacity]{set_cache_capacity}}{}
+//' \item{\link[=SPLITT::TraversalTask::ClearCache]{ClearCache}}{}
+//' \item{\link[=SPLITT::TraversalTask::SetData]{SetData}}{}
 //' }
 //' @seealso \link{SPLITT::TraversalSpecification}  
 //' @seealso \link{SPLITT} 
@@ -572,18 +662,129 @@ public:
   typedef typename TraversalSpecificationType::StateType StateType;
   
   TraversalTask(
-    std::vector<NodeType> const& branch_start_nodes,
-    std::vector<NodeType> const& branch_end_nodes,
-    std::vector<LengthType> const& branch_lengths,
+    VectorView<NodeType> const& branch_start_nodes,
+    VectorView<NodeType> const& branch_end_nodes,
+    VectorView<LengthType> const& branch_lengths,
     DataType const& data):
     tree_(branch_start_nodes, branch_end_nodes, branch_lengths),
     spec_(tree_, data),
-    algorithm_(tree_, spec_) {}
+    algorithm_(tree_, spec_),
+    cache_capacity_(0),
+    num_cache_hits_(0),
+    num_cache_misses_(0) {}
   
   StateType TraverseTree(ParameterType const& par, uint mode) {
+    if(cache_capacity_ == 0) {
+      spec_.SetParameter(par);
+      algorithm_.TraverseTree(static_cast<ModeType>(mode));
+      return spec_.StateAtRoot();
+    }
+    
+    if(ContainsNaN(par)) {
+      // NaN != NaN, so such a parameter would never be found in the cache.
+      spec_.SetParameter(par);
+      algorithm_.TraverseTree(static_cast<ModeType>(mode));
+      return spec_.StateAtRoot();
+    }
+    
+    auto it = cache_map_.find(par);
+    if(it != cache_map_.end()) {
+      num_cache_hits_++;
+      // move the entry to the front, i.e. make it the most recently used.
+      cache_list_.splice(cache_list_.begin(), cache_list_, it->second);
+      return it->second->state;
+    }
+    
+    num_cache_misses_++;
     spec_.SetParameter(par);
     algorithm_.TraverseTree(static_cast<ModeType>(mode));
-    return spec_.StateAtRoot();
+    cache_list_.push_front(CacheEntry{par, spec_.StateAtRoot()});
+    cache_map_.emplace(par, cache_list_.begin());
+    if(cache_list_.size() > cache_capacity_) {
+      EvictLeastRecentlyUsed();
+    }
+    return cache_list_.front().state;
+  }
+  
+//' @name SPLITT::TraversalTask::set_cache_capacity
+//' 
+//' @title Enable the memoisation of the states at the root for the last 
+//' \code{capacity} distinct parameters.
+//' 
+//' @description 
+//' \code{
+//' void set_cache_capacity(\link[=SPLITT::uint]{uint} capacity);}
+//' 
+//' If \code{capacity} is positive, \code{TraverseTree(par, mode)} returns 
+//' the stored state at the root, without traversing the tree, when called 
+//' with a parameter equal to one of the last \code{capacity} distinct 
+//' parameters; the least recently used parameter is evicted when the cache
+//' is full. The parameters are compared with \code{==} regardless of the 
+//' mode; parameters containing NaN are never stored. A value of 0 (the 
+//' default) disables the cache. The per-node states 
+//' (e.g. \code{StateAtNode}) are those of the last traversal, which may not
+//' correspond to the last call to \code{TraverseTree}. After a change of the
+//' tree or the data, the cache must be cleared with 
+//' \link[=SPLITT::TraversalTask::ClearCache]{ClearCache}.
+//' 
+//' @family public methods in SPLITT::TraversalTask
+//' @seealso \link{SPLITT} 
+  void set_cache_capacity(uint capacity) {
+    cache_capacity_ = capacity;
+    while(cache_list_.size() > cache_capacity_) {
+      EvictLeastRecentlyUsed();
+    }
+    // The map holds at most capacity + 1 entries. Its values, iterators in
+    // cache_list_, stay valid when reserve rehashes the map.
+    cache_map_.reserve(cache_capacity_ + 1);
+  }
+  uint cache_capacity() const {
+    return cache_capacity_;
+  }
+  // the numbers of calls to TraverseTree returning a stored state or 
+  // traversing the tree while the cache is enabled.
+  uint num_cache_hits() const {
+    return num_cache_hits_;
+  }
+  uint num_cache_misses() const {
+    return num_cache_misses_;
+  }
+  
+//' @name SPLITT::TraversalTask::ClearCache
+//' 
+//' @title Remove all states stored in the cache and reset the hit and miss 
+//' counters.
+//' 
+//' @description 
+//' \code{
+//' void ClearCache();}
+//' 
+//' @family public methods in SPLITT::TraversalTask
+//' @seealso \link{SPLITT} 
+  void ClearCache() {
+    cache_list_.clear();
+    cache_map_.clear();
+    num_cache_hits_ = num_cache_misses_ = 0;
+  }
+  
+//' @name SPLITT::TraversalTask::SetData
+//' 
+//' @title Replace the data of the traversal specification.
+//' 
+//' @description 
+//' \code{
+//' void SetData(DataType const& data);}
+//' 
+//' Passes \code{data} to the \code{SetData} method of the traversal 
+//' specification, which must be defined for the specification type. The 
+//' tree, the algorithm and its tuned mode are kept, while the cache of 
+//' states at the root is cleared.
+//' 
+//' @family public methods in SPLITT::TraversalTask
+//' @seealso \link{SPLITT} 
+  void SetData(DataType const& data) {
+    ClearCache();
+    spec_.SetData(data);
   }
   
   StateType StateAtNode(uint i) {
@@ -604,6 +805,28 @@ protected:
   TreeType tree_;
   TraversalSpecification spec_;
   AlgorithmType algorithm_;
+  
+  // least recently used cache of the states at the root: the list holds 
+  // the parameters and states from the most to the least recently used one,
+  // and the map finds the list entry of a parameter. The list keeps the 
+  // parameter, not an iterator in the map, which a rehash would invalidate.
+  struct CacheEntry {
+    ParameterType par;
+    StateType state;
+  };
+  typedef std::list<CacheEntry> CacheListType;
+  typedef std::unordered_map<ParameterType, typename CacheListType::iterator, 
+                             HashVector> CacheMapType;
+  uint cache_capacity_;
+  uint num_cache_hits_;
+  uint num_cache_misses_;
+  CacheListType cache_list_;
+  CacheMapType cache_map_;
+  
+  void EvictLeastRecentlyUsed() {
+    cache_map_.erase(cache_list_.back().par);
+    cache_list_.pop_back();
+  }
 };
 
 //' @name SPLITT::TraversalTaskLightweight
@@ -649,6 +872,16 @@ public:
     spec_(tree_, data),
     algorithm_(tree_, spec_) {}
   
+  // The spec is constructed from the spec of another task on the same tree,
+  // which requires a constructor TraversalSpecification(tree, other_spec), 
+  // e.g. to share the quantities depending only on the tree and the data.
+  TraversalTaskLightweight(
+    TreeType const& tree,
+    TraversalSpecification const& other_spec):
+    tree_(tree),
+    spec_(tree_, other_spec),
+    algorithm_(tree_, spec_) {}
+  
   StateType TraverseTree(ParameterType const& par, uint mode) {
     spec_.SetParameter(par);
     algorithm_.TraverseTree(static_cast<ModeType>(mode));
@@ -755,14 +988,16 @@ protected:
   MapType map_node_to_id_;
   std::vector<NodeType> map_id_to_node_;
   std::vector<LengthType> lengths_;
+  // the children of each node indexed by id (empty for the tips), so that
+  // adding tips does not shift the vectors of the internal nodes.
   std::vector<uvec> id_child_nodes_;
 
   void init_id_child_nodes() {
-    id_child_nodes_ = std::vector<uvec>(this->num_nodes() - this->num_tips());
+    id_child_nodes_ = std::vector<uvec>(this->num_nodes());
 
     // fill child vectors
     for(uint i = 0; i < this->num_nodes() - 1; i++) {
-      id_child_nodes_[this->FindIdOfParent(i) - this->num_tips()].push_back(i);
+      id_child_nodes_[this->FindIdOfParent(i)].push_back(i);
     }
   }
 
@@ -773,32 +1008,34 @@ public:
 //' 
 //' @description 
 //' \code{
-//' Tree(std::vector<NodeType> const& branch_start_nodes,
-//' std::vector<NodeType> const& branch_end_nodes,
-//' std::vector<LengthType> const& branch_lengths);}
+//' Tree(VectorView<NodeType> const& branch_start_nodes,
+//' VectorView<NodeType> const& branch_end_nodes,
+//' VectorView<LengthType> const& branch_lengths);}
 //' 
 //' Constructs the tree object given a list of branches. The list of branches
 //' is specified from the corresponding elements in the three vectors passed as
-//' arguments. 
+//' arguments. The vectors are only read during the construction, so they can
+//' be views of memory owned by the calling application (see 
+//' \code{\link[=SPLITT::VectorView]{VectorView}}).
 //' 
 //' @param branch_start_nodes 
-//' \href{http://en.cppreference.com/w/cpp/container/vector}{\code{std::vector}}\code{<\link[=SPLITT::Tree::NodeType]{NodeType}> const&}: 
+//' \code{\link[=SPLITT::VectorView]{VectorView}<\link[=SPLITT::Tree::NodeType]{NodeType}> const&}: 
 //'   starting node for every branch in the tree.
 //' @param branch_end_nodes 
-//' \href{http://en.cppreference.com/w/cpp/container/vector}{\code{std::vector}}\code{<\link[=SPLITT::Tree::NodeType]{NodeType}> const&}:
+//' \code{\link[=SPLITT::VectorView]{VectorView}<\link[=SPLITT::Tree::NodeType]{NodeType}> const&}:
 //'   ending node for every branch in the tree; must be the same length as 
 //'   \code{branch_start_nodes}.
 //' @param branch_lengths 
-//' \href{http://en.cppreference.com/w/cpp/container/vector}{\code{std::vector}}\code{<\link[=SPLITT::Tree::LengthType]{LengthType}> const&}: 
+//' \code{\link[=SPLITT::VectorView]{VectorView}<\link[=SPLITT::Tree::LengthType]{LengthType}> const&}: 
 //' lengths associated with the branches. Pass an empty vector for \code{branch_lengths} 
 //' for a tree without branch lengths (i.e. only a topology).
 //'
 //' @family public methods in SPLITT::Tree 
 //' @seealso \code{\link[=SPLITT::Tree]{Tree}}
 //' @seealso \link{SPLITT} 
-Tree(std::vector<NodeType> const& branch_start_nodes,
-       std::vector<NodeType> const& branch_end_nodes,
-       std::vector<LengthType> const& branch_lengths) {
+Tree(VectorView<NodeType> const& branch_start_nodes,
+       VectorView<NodeType> const& branch_end_nodes,
+       VectorView<LengthType> const& branch_lengths) {
 
     if(branch_start_nodes.size() != branch_end_nodes.size()) {
       std::ostringstream oss;
@@ -1244,8 +1481,8 @@ uint FindIdOfParent(uint id_child) const {
 uvec const& FindChildren(uint i) const {
     if(i < this->num_tips()) {
       return G_EMPTY_UVEC;
-    } else if(i - this->num_tips() < id_child_nodes_.size()) {
-      return id_child_nodes_[i - this->num_tips()];
+    } else if(i < id_child_nodes_.size()) {
+      return id_child_nodes_[i];
     } else {
       throw std::invalid_argument("ERR:01061:SPLITT:SPLITT.h:FindChildren:: i must be smaller than the number of nodes.");
     }
@@ -1385,6 +1622,33 @@ private:
 protected:
   uvec ranges_id_visit_;
   uvec ranges_id_prune_;
+  // false after a topology edit until the next call to Reorder().
+  bool is_ordered_;
+
+  // replace the child i_old of node i_parent by i_new.
+  void ReplaceChild(uint i_parent, uint i_old, uint i_new) {
+    uvec& children = this->id_child_nodes_[i_parent];
+    *std::find(children.begin(), children.end(), i_old) = i_new;
+  }
+
+  // move the node with id i_old to the unused id i_new.
+  void MoveNode(uint i_old, uint i_new, bool is_root) {
+    NodeType node = this->map_id_to_node_[i_old];
+    this->map_id_to_node_[i_new] = node;
+    this->map_node_to_id_[node] = i_new;
+    if(!is_root) {
+      uint i_parent = this->id_parent_[i_old];
+      this->id_parent_[i_new] = i_parent;
+      ReplaceChild(i_parent, i_old, i_new);
+      if(this->HasBranchLengths()) {
+        this->lengths_[i_new] = this->lengths_[i_old];
+      }
+    }
+    std::swap(this->id_child_nodes_[i_new], this->id_child_nodes_[i_old]);
+    for(uint i: this->id_child_nodes_[i_new]) {
+      this->id_parent_[i] = i_new;
+    }
+  }
 
 public:
 
@@ -1394,24 +1658,26 @@ public:
 //' 
 //' @description 
 //' \code{
-//' OrderedTree(std::vector<NodeType> const& branch_start_nodes,
-//' std::vector<NodeType> const& branch_end_nodes,
-//' std::vector<LengthType> const& branch_lengths);}
+//' OrderedTree(VectorView<NodeType> const& branch_start_nodes,
+//' VectorView<NodeType> const& branch_end_nodes,
+//' VectorView<LengthType> const& branch_lengths);}
 //' 
 //' Constructs the tree object given a list of branches. The list of branches
 //'   is specified from the corresponding elements in the three vectors passed as
 //'   arguments. Creates the internal data-objects needed for ordered traversal 
-//'   of the nodes in the tree. 
+//'   of the nodes in the tree. The vectors are only read during the 
+//'   construction, so they can be views of memory owned by the calling 
+//'   application (see \code{\link[=SPLITT::VectorView]{VectorView}}).
 //' 
 //' @param branch_start_nodes 
-//' \href{http://en.cppreference.com/w/cpp/container/vector}{\code{std::vector}}\code{<\link[=SPLITT::OrderedTree::NodeType]{NodeType}> const&}: 
+//' \code{\link[=SPLITT::VectorView]{VectorView}<\link[=SPLITT::OrderedTree::NodeType]{NodeType}> const&}: 
 //'   starting node for every branch in the tree.
 //' @param branch_end_nodes 
-//' \href{http://en.cppreference.com/w/cpp/container/vector}{\code{std::vector}}\code{<\link[=SPLITT::OrderedTree::NodeType]{NodeType}> const&}:
+//' \code{\link[=SPLITT::VectorView]{VectorView}<\link[=SPLITT::OrderedTree::NodeType]{NodeType}> const&}:
 //'   ending node for every branch in the tree; must be the same length as 
 //'   \code{branch_start_nodes}.
 //' @param branch_lengths 
-//' \href{http://en.cppreference.com/w/cpp/container/vector}{\code{std::vector}}\code{<\link[=SPLITT::OrderedTree::LengthType]{LengthType}> const&}: 
+//' \code{\link[=SPLITT::VectorView]{VectorView}<\link[=SPLITT::OrderedTree::LengthType]{LengthType}> const&}: 
 //' lengths associated with the branches. Pass an empty vector for \code{branch_lengths} 
 //' for a tree without branch lengths (i.e. only a topology).
 //'
@@ -1419,12 +1685,43 @@ public:
 //' @seealso \code{\link[=SPLITT::OrderedTree]{OrderedTree}} \code{\link[=SPLITT::Tree]{Tree}} \code{\link[=SPLITT::Tree::Tree]{Tree::Tree()}}
 //' @seealso \link{SPLITT} 
   OrderedTree(
-    std::vector<NodeType> const& branch_start_nodes,
-    std::vector<NodeType> const& branch_end_nodes,
-    std::vector<LengthType> const& branch_lengths):
+    VectorView<NodeType> const& branch_start_nodes,
+    VectorView<NodeType> const& branch_end_nodes,
+    VectorView<LengthType> const& branch_lengths):
   Tree<NodeType, LengthType>(branch_start_nodes, branch_end_nodes, branch_lengths),
   ranges_id_visit_(1, 0),
-  ranges_id_prune_(1, 0) {
+  ranges_id_prune_(1, 0),
+  is_ordered_(false) {
+    Reorder();
+  }
+
+//' @name SPLITT::OrderedTree::Reorder
+//' 
+//' @title Assign new ids to the nodes according to the levels of parallel 
+//' \code{VisitNode} operations.
+//' 
+//' @description 
+//' \code{
+//' \link[=SPLITT::uvec]{uvec} Reorder();}
+//' 
+//' Called by the constructor and after topology edits (see 
+//' \link[=SPLITT::OrderedTree::SubtreePruneAndRegraft]{SubtreePruneAndRegraft}
+//' and \link[=SPLITT::OrderedTree::NearestNeighborInterchange]{NearestNeighborInterchange}),
+//' which leave the ids of the nodes unchanged and, therefore, can break the 
+//' order of the ids required by the post-order traversal algorithms. The 
+//' tips keep ids from 0 to N-1 and the root keeps the id M-1. The cost is 
+//' linear in the number of nodes.
+//' 
+//' @return \code{\link[=SPLITT::uvec]{uvec}}: the vector of the old ids of the
+//' nodes in the order of their new ids.
+//' 
+//' @family public methods in SPLITT::OrderedTree
+//' @seealso \code{\link[=SPLITT::OrderedTree]{OrderedTree}}
+//' @seealso \link{SPLITT} 
+  uvec Reorder() {
+    ranges_id_visit_ = uvec(1, 0);
+    ranges_id_prune_ = uvec(1, 0);
+
 
     // insert a fictive branch leading to the root of the tree.
     uvec branch_ends = Seq(uint(0), this->num_nodes_ - 1);
@@ -1512,6 +1809,293 @@ public:
     std::swap(this->map_id_to_node_, map_id_to_node);
 
     this->init_id_child_nodes();
+    is_ordered_ = true;
+    return id_old;
+  }
+
+//' @name SPLITT::OrderedTree::is_ordered
+//' 
+//' @title Do the ids of the nodes follow the order needed for post-order traversal?
+//' 
+//' @description 
+//' \code{
+//' bool is_ordered() const;}
+//' 
+//' @return \code{false} after a topology edit until the next call to 
+//' \link[=SPLITT::OrderedTree::Reorder]{Reorder}, \code{true} otherwise.
+//' 
+//' @family public methods in SPLITT::OrderedTree
+//' @seealso \code{\link[=SPLITT::OrderedTree]{OrderedTree}}
+//' @seealso \link{SPLITT} 
+  bool is_ordered() const {
+    return is_ordered_;
+  }
+
+//' @name SPLITT::OrderedTree::SubtreePruneAndRegraft
+//' 
+//' @title Move a subtree to another branch of the tree (SPR).
+//' 
+//' @description 
+//' \code{
+//' \link[=SPLITT::uvec]{uvec} SubtreePruneAndRegraft(\link[=SPLITT::uint]{uint} i, \link[=SPLITT::uint]{uint} j, 
+//' LengthType const& position);}
+//' 
+//' The subtree rooted at the node with id i is pruned together with its parent 
+//' p, which must have exactly two children and must not be the root. The 
+//' sibling c of i takes the place of p, the length of its branch becoming the 
+//' sum of the lengths of the branches leading to c and p. Then, p is inserted
+//' on the branch leading to the node with id j, which must not be the root or
+//' in the subtree rooted at p, at distance \code{position} from j (see 
+//' \link[=SPLITT::OrderedTree::InsertTip]{InsertTip}). The move is reversed 
+//' by regrafting i on the branch leading to c at distance equal to the 
+//' length of the branch leading to c before the move.
+//' 
+//' The ids of the nodes do not change, so the tree is no longer ordered (see
+//' \link[=SPLITT::OrderedTree::Reorder]{Reorder}). The cost does not depend 
+//' on the size of the tree, except for the check that j is not in the 
+//' subtree rooted at i, which takes time proportional to the depth of j.
+//' 
+//' @return \code{\link[=SPLITT::uvec]{uvec}}: the ids of the nodes c, p and j, 
+//' i.e. the nodes whose parent or branch length have changed.
+//' 
+//' @family public methods in SPLITT::OrderedTree
+//' @seealso \code{\link[=SPLITT::OrderedTree]{OrderedTree}}
+//' @seealso \link{SPLITT} 
+  uvec SubtreePruneAndRegraft(uint i, uint j, LengthType const& position) {
+    uint i_root = this->num_nodes_ - 1;
+    if(i >= i_root || j >= i_root) {
+      throw std::invalid_argument("ERR:01081:SPLITT:SPLITT.h:SubtreePruneAndRegraft:: i and j must be ids of nodes other than the root.");
+    }
+    uint p = this->id_parent_[i];
+    if(p == i_root || this->FindChildren(p).size() != 2) {
+      throw std::logic_error("ERR:01082:SPLITT:SPLITT.h:SubtreePruneAndRegraft:: The parent of i must have exactly two children and must not be the root.");
+    }
+    for(uint k = j; k != i_root; k = this->id_parent_[k]) {
+      if(k == i || k == p) {
+        throw std::logic_error("ERR:01083:SPLITT:SPLITT.h:SubtreePruneAndRegraft:: j must not be in the subtree rooted at the parent of i.");
+      }
+    }
+    if(this->HasBranchLengths() && (position < 0 || position > this->lengths_[j])) {
+      throw std::invalid_argument("ERR:01089:SPLITT:SPLITT.h:SubtreePruneAndRegraft:: position must be between 0 and the length of the branch leading to j.");
+    }
+    uvec const& children_p = this->FindChildren(p);
+    uint c = children_p[0] == i? children_p[1]: children_p[0];
+    uint g = this->id_parent_[p];
+
+    // prune
+    this->id_parent_[c] = g;
+    ReplaceChild(g, p, c);
+
+    // regraft
+    uint q = this->id_parent_[j];
+    this->id_parent_[p] = q;
+    ReplaceChild(q, j, p);
+    this->id_parent_[j] = p;
+    ReplaceChild(p, c, j);
+
+    if(this->HasBranchLengths()) {
+      this->lengths_[c] += this->lengths_[p];
+      this->lengths_[p] = this->lengths_[j] - position;
+      this->lengths_[j] = position;
+    }
+
+    is_ordered_ = false;
+    return uvec({c, p, j});
+  }
+
+//' @name SPLITT::OrderedTree::NearestNeighborInterchange
+//' 
+//' @title Interchange two subtrees across an internal branch (NNI).
+//' 
+//' @description 
+//' \code{
+//' \link[=SPLITT::uvec]{uvec} NearestNeighborInterchange(\link[=SPLITT::uint]{uint} i, \link[=SPLITT::uint]{uint} j);}
+//' 
+//' The node with id i, a child of the node u, and the node with id j, a 
+//' sibling of u, exchange their parents. The branch lengths do not change.
+//' 
+//' The ids of the nodes do not change, so the tree is no longer ordered (see
+//' \link[=SPLITT::OrderedTree::Reorder]{Reorder}). The cost does not depend 
+//' on the size of the tree.
+//' 
+//' @return \code{\link[=SPLITT::uvec]{uvec}}: the ids i and j of the nodes whose
+//' parent has changed.
+//' 
+//' @family public methods in SPLITT::OrderedTree
+//' @seealso \code{\link[=SPLITT::OrderedTree]{OrderedTree}}
+//' @seealso \link{SPLITT} 
+  uvec NearestNeighborInterchange(uint i, uint j) {
+    uint i_root = this->num_nodes_ - 1;
+    if(i >= i_root || j >= i_root) {
+      throw std::invalid_argument("ERR:01084:SPLITT:SPLITT.h:NearestNeighborInterchange:: i and j must be ids of nodes other than the root.");
+    }
+    uint u = this->id_parent_[i];
+    if(u == i_root || u == j || this->id_parent_[u] != this->id_parent_[j]) {
+      throw std::logic_error("ERR:01085:SPLITT:SPLITT.h:NearestNeighborInterchange:: j must be a sibling of the parent of i.");
+    }
+    uint v = this->id_parent_[j];
+    this->id_parent_[i] = v;
+    this->id_parent_[j] = u;
+    ReplaceChild(u, i, j);
+    ReplaceChild(v, j, i);
+
+    is_ordered_ = false;
+    return uvec({i, j});
+  }
+
+//' @name SPLITT::OrderedTree::InsertTip
+//' 
+//' @title Attach a new tip on an existing branch.
+//' 
+//' @description 
+//' \code{
+//' \link[=SPLITT::uvec]{uvec} InsertTip(\link[=SPLITT::uint]{uint} j, 
+//' NodeType const& tip_node, NodeType const& node, 
+//' LengthType const& position, LengthType const& length_tip);}
+//' 
+//' A new internal node \code{node} is inserted on the branch leading to the 
+//' node with id j, at distance \code{position} from j, and a new tip 
+//' \code{tip_node} is attached to it by a branch of length 
+//' \code{length_tip}. 
+//' 
+//' The new tip gets the id N and the new internal node gets the id M, where N 
+//' and M are the numbers of tips and nodes before the insertion. To keep 
+//' the tips, the internal nodes and the root in their id ranges, the root 
+//' is moved to id M+1 and the internal node with id N, if it is not the 
+//' root, is moved to id M-1 (see 
+//' \link[=SPLITT::OrderedTree::IdAfterInsertTip]{IdAfterInsertTip}). 
+//' The ids of all other nodes do not change, so the tree is no longer ordered
+//' (see \link[=SPLITT::OrderedTree::Reorder]{Reorder}). The internal vectors
+//' grow with amortised constant cost, so the insertion does not depend on 
+//' the size of the tree.
+//' 
+//' @return \code{\link[=SPLITT::uvec]{uvec}}: the ids of the new tip, the new
+//' internal node and the node j (after the insertion).
+//' 
+//' @family public methods in SPLITT::OrderedTree
+//' @seealso \code{\link[=SPLITT::OrderedTree]{OrderedTree}}
+//' @seealso \link{SPLITT} 
+  uvec InsertTip(uint j, NodeType const& tip_node, NodeType const& node,
+                 LengthType const& position, LengthType const& length_tip) {
+    uint num_tips = this->num_tips_;
+    uint num_nodes = this->num_nodes_;
+    bool has_lengths = this->HasBranchLengths();
+    if(j >= num_nodes - 1) {
+      throw std::invalid_argument("ERR:01086:SPLITT:SPLITT.h:InsertTip:: j must be the id of a node other than the root.");
+    }
+    if(this->map_node_to_id_.count(tip_node) || this->map_node_to_id_.count(node) ||
+       tip_node == node) {
+      throw std::invalid_argument("ERR:01087:SPLITT:SPLITT.h:InsertTip:: tip_node and node must be different from each other and from the nodes in the tree.");
+    }
+    if(has_lengths &&
+       (position < 0 || position > this->lengths_[j] || length_tip < 0)) {
+      throw std::invalid_argument("ERR:01088:SPLITT:SPLITT.h:InsertTip:: position must be between 0 and the length of the branch leading to j and length_tip must be non-negative.");
+    }
+
+    this->id_parent_.resize(num_nodes + 1);
+    if(has_lengths) {
+      this->lengths_.resize(num_nodes + 1);
+    }
+    this->map_id_to_node_.resize(num_nodes + 2);
+    this->id_child_nodes_.resize(num_nodes + 2);
+
+    MoveNode(num_nodes - 1, num_nodes + 1, true);
+    if(num_tips != num_nodes - 1) {
+      MoveNode(num_tips, num_nodes - 1, false);
+    }
+    this->num_tips_ = num_tips + 1;
+    this->num_nodes_ = num_nodes + 2;
+    j = IdAfterInsertTip(j);
+
+    uint i_tip = num_tips, i_node = num_nodes;
+    uint i_parent = this->id_parent_[j];
+    
+    this->map_id_to_node_[i_tip] = tip_node;
+    this->map_node_to_id_[tip_node] = i_tip;
+    this->map_id_to_node_[i_node] = node;
+    this->map_node_to_id_[node] = i_node;
+
+    this->id_child_nodes_[i_tip].clear();
+    this->id_child_nodes_[i_node] = uvec({j, i_tip});
+    ReplaceChild(i_parent, j, i_node);
+    this->id_parent_[i_node] = i_parent;
+    this->id_parent_[j] = i_node;
+    this->id_parent_[i_tip] = i_node;
+
+    if(has_lengths) {
+      this->lengths_[i_node] = this->lengths_[j] - position;
+      this->lengths_[j] = position;
+      this->lengths_[i_tip] = length_tip;
+    }
+
+    is_ordered_ = false;
+    return uvec({i_tip, i_node, j});
+  }
+
+//' @name SPLITT::OrderedTree::IdAfterInsertTip
+//' 
+//' @title The id of a node after the last call to 
+//' \link[=SPLITT::OrderedTree::InsertTip]{InsertTip}.
+//' 
+//' @description 
+//' \code{
+//' \link[=SPLITT::uint]{uint} IdAfterInsertTip(\link[=SPLITT::uint]{uint} i) const;}
+//' 
+//' @param i the id of a node before the insertion.
+//' 
+//' @return \code{\link[=SPLITT::uint]{uint}}: the id of the same node after 
+//' the insertion.
+//' 
+//' @family public methods in SPLITT::OrderedTree
+//' @seealso \code{\link[=SPLITT::OrderedTree]{OrderedTree}}
+//' @seealso \link{SPLITT} 
+  uint IdAfterInsertTip(uint i) const {
+    // number of tips and number of nodes before the insertion
+    uint num_tips = this->num_tips_ - 1;
+    uint num_nodes = this->num_nodes_ - 2;
+    if(i == num_nodes - 1) {
+      return num_nodes + 1;
+    } else if(i == num_tips) {
+      return num_nodes - 1;
+    } else {
+      return i;
+    }
+  }
+
+//' @name SPLITT::OrderedTree::MoveValuesAfterInsertTip
+//' 
+//' @title Update a vector of per-node values after the last call to 
+//' \link[=SPLITT::OrderedTree::InsertTip]{InsertTip}.
+//' 
+//' @description 
+//' \code{
+//' template<class VectorValues> 
+//' void MoveValuesAfterInsertTip(VectorValues& v, bool per_branch = false) const;}
+//' 
+//' Grows the vector v, indexed by node id, and moves the values of the nodes 
+//' whose ids have changed. The values of the new nodes are left unspecified.
+//' 
+//' @param v a vector with an element for each node (if \code{per_branch} is
+//' \code{false}) or for each node except the root (if \code{per_branch} is 
+//' \code{true}) before the insertion. 
+//' @param per_branch logical (see v).
+//' 
+//' @family public methods in SPLITT::OrderedTree
+//' @seealso \code{\link[=SPLITT::OrderedTree]{OrderedTree}}
+//' @seealso \link{SPLITT} 
+  template<class VectorValues>
+  void MoveValuesAfterInsertTip(VectorValues& v, bool per_branch = false) const {
+    uint num_tips = this->num_tips_ - 1;
+    uint num_nodes = this->num_nodes_ - 2;
+    if(per_branch) {
+      v.resize(num_nodes + 1);
+    } else {
+      v.resize(num_nodes + 2);
+      v[num_nodes + 1] = v[num_nodes - 1];
+    }
+    if(num_tips != num_nodes - 1) {
+      v[num_nodes - 1] = v[num_tips];
+    }
   }
 
 //' @name SPLITT::OrderedTree::num_levels
@@ -1732,6 +2316,13 @@ public:
     }
   }
   
+  // non-thread-safe. Called after the number of nodes in the tree has
+  // changed; should call Init() before using.
+  void Resize() {
+    queue_.resize(ref_tree_.num_nodes());
+    num_non_visited_children_.resize(ref_tree_.num_nodes() - ref_tree_.num_tips());
+  }
+  
   // non-thread-safe. should call Init() before using.
   VisitQueue(TreeType const& tree):
   ref_tree_(tree),
@@ -1790,9 +2381,17 @@ public:
   ref_spec_(spec),
   num_children_(tree.num_nodes() - tree.num_tips()),
   visit_queue_(tree) {
-    for(uint i = tree.num_tips(); i < tree.num_nodes(); i++) {
-      num_children_[i - tree.num_tips()] = tree.FindChildren(i).size();
+    UpdateTopology();
+  }
+
+  // Recalculate the number of children of each internal node. Called after 
+  // a change of the topology of the tree (see OrderedTree::Reorder).
+  void UpdateTopology() {
+    num_children_.resize(ref_tree_.num_nodes() - ref_tree_.num_tips());
+    for(uint i = ref_tree_.num_tips(); i < ref_tree_.num_nodes(); i++) {
+      num_children_[i - ref_tree_.num_tips()] = ref_tree_.FindChildren(i).size();
     }
+    visit_queue_.Resize();
   }
 
   uint NumOmpThreads() const {
@@ -29,43 +29,79 @@
 
 #include "ThreePointUnivariate.h"
 #include "NumericTraitData.h"
+#include <memory>
 
 using namespace SPLITT;
 
 namespace ThreePointUsingSPLITT {
 
-template<class Tree>
-class ThreePointPMM: public ThreePointUnivariate<Tree> {
+template<class Tree, class Storage = double>
+class ThreePointPMM: public ThreePointUnivariateSymmetric<Tree, Storage> {
 
 public:
-  typedef ThreePointPMM<Tree> MyType;
+  typedef ThreePointPMM<Tree, Storage> MyType;
   typedef Tree TreeType;
   typedef PostOrderTraversal<MyType> AlgorithmType;
-  typedef ThreePointUnivariate<TreeType> BaseType;
+  typedef ThreePointUnivariateSymmetric<TreeType, Storage> BaseType;
   typedef vec ParameterType;
   typedef NumericTraitData<typename TreeType::NodeType> DataType;
   typedef vec StateType;
+  typedef typename BaseType::Value Value;
+  typedef typename BaseType::ValueVec ValueVec;
+
+  // The trait data, which can be shared by several specs on the same tree
+  // (see ThreePointPOUMM::DataDerivedState).
+  struct DataDerivedState {
+    SPLITT::vec x;
+  };
+  std::shared_ptr<DataDerivedState> data_derived_;
 
   // univariate trait vector
-  SPLITT::vec x;
-  double x0, sigma2, sigmae2;
+  SPLITT::vec& x;
+  // the parameters; with dual number storage, these are seeded as independent
+  // variables in the derivative lanes 0, 1 and 2 (see SetParameter).
+  Value x0, sigma2, sigmae2;
 
 
   ThreePointPMM(
     TreeType const& tree, DataType const& input_data):
-    BaseType(tree) {
+    BaseType(tree),
+    data_derived_(new DataDerivedState),
+    x(data_derived_->x) {
 
     if(input_data.x_.size() != this->ref_tree_.num_tips()) {
       throw std::invalid_argument("ERR:01201:SPLITT:ThreePointPMM.h:ThreePointPMM:: The vector x must be the same length as the number of tips.");
     } else {
 
-      uvec ordNodes = this->ref_tree_.OrderNodes(input_data.names_);
-      this->x = At(input_data.x_, ordNodes);
+      this->x.resize(this->ref_tree_.num_tips());
+      input_data.CopyValuesInTipOrder(this->ref_tree_, this->x);
       vec X(this->ref_tree_.num_tips());
-      this->set_X_and_Y(X, X);
+      this->set_X(X);
     }
   }
 
+  // A spec on tree sharing the trait data with other, a spec on the same 
+  // tree (see ThreePointPOUMM).
+  ThreePointPMM(TreeType const& tree, ThreePointPMM const& other):
+    BaseType(tree),
+    data_derived_(other.data_derived_),
+    x(data_derived_->x) {
+    vec X(this->ref_tree_.num_tips());
+    this->set_X(X);
+  }
+
+  // Replace the trait values at the tips, keeping the tree and all other
+  // per-node quantities.
+  void SetData(DataType const& input_data) {
+    input_data.CopyValuesInTipOrder(this->ref_tree_, this->x);
+  }
+
+  // Replace the trait values after the tree has been replaced by another
+  // tree with the same numbers of tips and nodes (see ThreePointPOUMM).
+  void ReplaceTree(vec const& x_tips) {
+    std::copy(x_tips.begin(), x_tips.end(), x.begin());
+  }
+
   void SetParameter(ParameterType const& par) {
     if(par.size() != 3) {
       throw std::invalid_argument(
@@ -75,31 +111,116 @@ public:
     if(par[1] <= 0 || par[2] <= 0 ) {
       throw std::logic_error("ERR:01212:SPLITT:ThreePointPMM.h:SetParameter:: The parameters sigma and sigmae should be positive.");
     }
-    this->x0 = par[0];
-    this->sigma2 = par[1];
-    this->sigmae2 = par[2];
+    this->x0 = Variable<Value>::Create(par[0], 0);
+    this->sigma2 = Variable<Value>::Create(par[1], 1);
+    this->sigmae2 = Variable<Value>::Create(par[2], 2);
   }
 
   inline void InitNode(uint i) {
-    ThreePointUnivariate<TreeType>::InitNode(i);
+    BaseType::InitNode(i);
     
     if(i < this->ref_tree_.num_nodes() - 1) {
       // if an internal node or a tip, transform the branch length leading to this tip
-      // The call to the parent's class InitNode method has set tTransf[i] to the branch-length.
-      this->tTransf[i] = sigma2 * this->tTransf[i];
+      Value t = sigma2 * this->ref_tree_.LengthOfBranch(i);
       if(i < this->ref_tree_.num_tips()) {
         // if an a tip, transform the branch length leading to this tip
-        this->X[i] = this->Y[i] = x[i] - x0;
-        this->tTransf[i] += sigmae2;
-      }  
+        this->X[i] = x[i] - x0;
+        t += sigmae2;
+      }
+      this->tTransf[i] = t;
     }
   }
   
+  // Only the transformed length of the branch leading to node i depends on
+  // its length (see TraversalTaskIncremental.h).
+  uvec UpdateBranchLength(uint i) {
+    return uvec(1, i);
+  }
+
+  // Set the trait value at tip i; only the transformed value X[i] depends on
+  // it (see TraversalTaskIncremental.h).
+  uvec UpdateTipValue(uint i, double value) {
+    x[i] = value;
+    return uvec(1, i);
+  }
+
+  // Update the per-node quantities after a tip with trait value value has
+  // been inserted in the tree with id i_tip (see OrderedTree::InsertTip).
+  // Returns the ids of the new tip, its parent and its sibling, whose 
+  // InitNode depends on the insertion.
+  uvec InsertTip(uint i_tip, double value) {
+    BaseType::MoveStateAfterInsertTip();
+    x.push_back(value);
+    uint i_node = this->ref_tree_.FindIdOfParent(i_tip);
+    uvec const& children = this->ref_tree_.FindChildren(i_node);
+    uint j = children[0] == i_tip? children[1]: children[0];
+    return uvec({i_tip, i_node, j});
+  }
+
+  // The values, besides the topology and the branch lengths of the subtree
+  // rooted at node i, on which the state of node i after VisitNode depends:
+  // the trait value of a tip (see TraversalTaskTreeSet.h).
+  vec HashInputsOfNode(uint i) const {
+    return i < this->ref_tree_.num_tips()? vec(1, x[i]): vec();
+  }
+
+  // Permute the trait values after the tree has assigned new ids to its
+  // nodes (see OrderedTree::Reorder).
+  void PermuteNodes(uvec const& id_old) {
+    x = At(x, uvec(id_old.begin(), id_old.begin() + this->ref_tree_.num_tips()));
+  }
+
+  // The log-likelihood; with dual number storage, followed by its
+  // derivatives with respect to x0, sigma2 and sigmae2.
   inline StateType StateAtRoot() const {
-    vec res(1);
-    double lnDetVRoot = this->lnDetV[this->ref_tree_.num_nodes() - 1];
-    double QRoot = this->Q[this->ref_tree_.num_nodes() - 1];
-    res[0] = -0.5*(this->ref_tree_.num_tips() * log(2*G_PI)+lnDetVRoot+QRoot);
+    vec res;
+    Value lnDetVRoot = this->lnDetV[this->ref_tree_.num_nodes() - 1];
+    Value QRoot = this->Q[this->ref_tree_.num_nodes() - 1];
+    Value ll = -0.5*(this->ref_tree_.num_tips() * log(2*G_PI)+lnDetVRoot+QRoot);
+    AppendValue(res, ll);
+    return res;
+  }
+
+  // The log-likelihood of each component of a forest (see OrderedForest.h),
+  // calculated from the quantities at the component roots after a
+  // traversal. Requires an OrderedForest as TreeType.
+  std::vector<StateType> StatesAtComponentRoots() const {
+    uint num_components = this->ref_tree_.num_components();
+    uvec component = this->ref_tree_.FindComponentOfNodes();
+    uvec num_tips(num_components, 0);
+    for(uint i = 0; i < this->ref_tree_.num_tips(); i++) {
+      num_tips[component[i]]++;
+    }
+    std::vector<StateType> res(num_components);
+    for(uint c = 0; c < num_components; c++) {
+      uint i = this->ref_tree_.FindIdOfComponentRoot(c);
+      Value ll = -0.5*(num_tips[c] * log(2*G_PI) + this->lnDetV[i] + this->Q[i]);
+      AppendValue(res[c], ll);
+    }
+    return res;
+  }
+
+  // The gradient of the log-likelihood with respect to x0, sigma2 and
+  // sigmae2, given the adjoints of tTransf and X calculated by a pre-order
+  // traversal after the last post-order traversal (see
+  // ThreePointUnivariateAdjoint.h).
+  ValueVec GradientFromAdjoints(ValueVec const& adj_tTransf, ValueVec const& adj_X) const {
+    ValueVec res(3, 0);
+    for(uint i = 0; i < this->ref_tree_.num_nodes() - 1; i++) {
+      res[1] += adj_tTransf[i] * this->ref_tree_.LengthOfBranch(i);
+    }
+    for(uint i = 0; i < this->ref_tree_.num_tips(); i++) {
+      res[0] -= adj_X[i];
+      res[2] += adj_tTransf[i];
+    }
+    return res;
+  }
+
+  // The gradient of the log-likelihood with respect to the length of the
+  // branch leading to each node (in the order of the node ids).
+  ValueVec BranchLengthGradientFromAdjoints(ValueVec const& adj_tTransf, ValueVec const& /*adj_X*/) const {
+    ValueVec res(adj_tTransf);
+    for(auto& r: res) r *= sigma2;
     return res;
   }
 };
@@ -0,0 +1,146 @@
+/*
+ *  ThreePointPMMProfile.h
+ *  SPLITT
+ *
+ * Copyright 2017 Venelin Mitov
+ *
+ * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+ * Lineage Traversal of Trees.
+ *
+ * SPLITT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SPLITT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SPLITT.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * @author Venelin Mitov
+ */
+
+#ifndef ThreePointPMMProfile_H_
+#define ThreePointPMMProfile_H_
+
+#include "ThreePointUnivariate.h"
+#include "NumericTraitData.h"
+#include <limits>
+
+using namespace SPLITT;
+
+namespace ThreePointUsingSPLITT {
+
+// PMM log-likelihood profiled over sigma2 (and optionally x0).
+//
+// The PMM covariance matrix is V = sigma2*(C + r*I), where C is the
+// phylogenetic covariance matrix and r = sigmae2/sigma2. For fixed r, the
+// traversal calculates log|W|, Q = X'W^(-1)X, 1'W^(-1)X and 1'W^(-1)1 for
+// W = C + r*I and X = x - mean(x). Then, |V| = sigma2^N |W| and the quadratic
+// form is (X - x0 + mean(x))'W^(-1)(X - x0 + mean(x))/sigma2, so that the
+// maximum likelihood estimates of sigma2 and x0 and the profile
+// log-likelihood follow in closed form. Since the tip values do not depend on
+// x0, a traversal is needed only when r changes.
+template<class Tree, class Storage = double>
+class ThreePointPMMProfile: public ThreePointUnivariateSymmetric<Tree, Storage> {
+
+public:
+  typedef ThreePointPMMProfile<Tree, Storage> MyType;
+  typedef Tree TreeType;
+  typedef PostOrderTraversal<MyType> AlgorithmType;
+  typedef ThreePointUnivariateSymmetric<TreeType, Storage> BaseType;
+  typedef vec ParameterType;
+  typedef NumericTraitData<typename TreeType::NodeType> DataType;
+  typedef vec StateType;
+
+  // univariate trait vector
+  SPLITT::vec x;
+  // mean of x
+  double x_mean;
+  double x0, r;
+
+  ThreePointPMMProfile(
+    TreeType const& tree, DataType const& input_data):
+    BaseType(tree) {
+
+    if(input_data.x_.size() != this->ref_tree_.num_tips()) {
+      throw std::invalid_argument("ERR:01231:SPLITT:ThreePointPMMProfile.h:ThreePointPMMProfile:: The vector x must be the same length as the number of tips.");
+    } else {
+
+      this->x.resize(this->ref_tree_.num_tips());
+      input_data.CopyValuesInTipOrder(this->ref_tree_, this->x);
+
+      // centering x improves the numerical accuracy of the quadratic form
+      // for values of x far from 0.
+      x_mean = 0;
+      for(auto xi : x) x_mean += xi;
+      x_mean /= x.size();
+
+      vec X(this->ref_tree_.num_tips());
+      for(uint i = 0; i < X.size(); i++) {
+        X[i] = x[i] - x_mean;
+      }
+      this->set_X(X);
+    }
+  }
+
+  void SetParameter(ParameterType const& par) {
+    if(par.size() != 2) {
+      throw std::invalid_argument(
+          "ERR:01232:SPLITT:ThreePointPMMProfile.h:SetParameter:: The par vector should be of length 2 with \
+      elements corresponding to x0 and r = sigmae2/sigma2.");
+    }
+    if(par[1] < 0) {
+      throw std::logic_error("ERR:01233:SPLITT:ThreePointPMMProfile.h:SetParameter:: The parameter r should be non-negative.");
+    }
+    this->x0 = par[0];
+    this->r = par[1];
+  }
+
+  inline void InitNode(uint i) {
+    BaseType::InitNode(i);
+    if(i < this->ref_tree_.num_tips()) {
+      this->tTransf[i] = this->ref_tree_.LengthOfBranch(i) + r;
+    }
+  }
+
+  // A vector containing the log-likelihood profiled over sigma2, the maximum
+  // likelihood estimate of sigma2 and the value of x0. If x0 is NaN, the
+  // log-likelihood is profiled over x0 as well and the third element is the
+  // maximum likelihood estimate of x0.
+  inline StateType StateAtRoot() const {
+    uint i_root = this->ref_tree_.num_nodes() - 1;
+    uint N = this->ref_tree_.num_tips();
+
+    double lnDetW = this->lnDetV[i_root];
+    // 1'W^(-1)X, 1'W^(-1)1 and X'W^(-1)X
+    double oneX = this->sum_hat_mu(this->hat_mu, i_root, N);
+    double oneOne = this->sum_p(this->p, i_root, N);
+    double QW = this->Q[i_root];
+
+    double x0_res;
+    if(std::isnan(x0)) {
+      x0_res = x_mean + oneX / oneOne;
+      QW -= oneX * oneX / oneOne;
+    } else {
+      double d = x0 - x_mean;
+      x0_res = x0;
+      QW += d * d * oneOne - 2 * d * oneX;
+    }
+
+    double sigma2_hat = QW / N;
+
+    vec res(3);
+    res[0] = -0.5*(N * log(2*G_PI) + N * log(sigma2_hat) + lnDetW + N);
+    res[1] = sigma2_hat;
+    res[2] = x0_res;
+    return res;
+  }
+};
+
+}
+#endif // ThreePointPMMProfile_H_
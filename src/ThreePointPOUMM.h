@@ -29,66 +29,290 @@
 
 #include "ThreePointUnivariate.h"
 #include "NumericTraitData.h"
+#include "VectorMath.h"
 #include <algorithm>
 #include <iostream>
+#include <limits>
+#include <memory>
 
 using namespace SPLITT;
 
 namespace ThreePointUsingSPLITT {
-template<class Tree>
-class ThreePointPOUMM: public ThreePointUnivariate<Tree> {
+template<class Tree, class Storage = double>
+class ThreePointPOUMM: public ThreePointUnivariateSymmetric<Tree, Storage> {
 
 public:
-  typedef ThreePointPOUMM<Tree> MyType;
+  typedef ThreePointPOUMM<Tree, Storage> MyType;
   typedef Tree TreeType;
   typedef PostOrderTraversal<MyType> AlgorithmType;
-  typedef ThreePointUnivariate<TreeType> BaseType;
+  typedef ThreePointUnivariateSymmetric<TreeType, Storage> BaseType;
   typedef vec ParameterType;
   typedef NumericTraitData<typename TreeType::NodeType> DataType;
   typedef vec StateType;
+  typedef typename BaseType::Value Value;
+  typedef typename BaseType::ValueVec ValueVec;
+
+  // The quantities depending only on the tree and the trait data. They are
+  // calculated once and can be shared by several specs on the same tree
+  // (see the constructor from another spec below).
+  struct DataDerivedState {
+    SPLITT::vec x, h, u;
+    double T, sum_u;
+  };
+  std::shared_ptr<DataDerivedState> data_derived_;
 
   // univariate trait vector
-  SPLITT::vec x;
+  SPLITT::vec& x;
   
   // tree height (maximum root-tip distance)
-  double T; 
+  double& T; 
   // h: height (distance from the root) for each node in the tree
-  SPLITT::vec h;
+  SPLITT::vec& h;
   // u: distance from the far-most tip for each node (, i.e. u[i] = T - h[i])
-  SPLITT::vec u;
+  SPLITT::vec& u;
   
-  double x0, alpha, theta, sigma2, sigmae2, e2alphaT, sum_u;
+  double& sum_u;
+  // the parameters; with dual number storage, these are seeded as independent
+  // variables in the derivative lanes 0, ..., 4 (see SetParameter).
+  Value x0, alpha, theta, sigma2, sigmae2, e2alphaT;
+
+  // Cache of the exponentials depending only on alpha and the tree. These are
+  // recalculated in SetParameter only when alpha changes, so that updates of
+  // x0, theta, sigma2 or sigmae2 do not trigger any call to exp.
+  //
+  // the value of alpha for which the cache has been calculated (NaN if the
+  // cache has not been calculated yet).
+  double alpha_cached;
+  // ealphahT[i] = exp(alpha*(h[i] - T)) for each node i; for a tip, this is
+  // equal to exp(-alpha*u[i]).
+  ValueVec ealphahT;
+  // tFactor[i] = (exp(2*alpha*(h[i] - T)) - exp(2*alpha*(h[iParent] - T))) / (2*alpha)
+  // for each node i except the root (h[i] - h[iParent] for alpha = 0). The
+  // transformed branch length is sigma2 * tFactor[i].
+  ValueVec tFactor;
+  // eminusalphah[i] = exp(-alpha*h[i]) for each tip i.
+  ValueVec eminusalphah;
   
   ThreePointPOUMM(
     TreeType const& tree, DataType const& input_data):
-    BaseType(tree) {
+    BaseType(tree),
+    data_derived_(new DataDerivedState),
+    x(data_derived_->x), T(data_derived_->T), h(data_derived_->h),
+    u(data_derived_->u), sum_u(data_derived_->sum_u) {
 
     if(input_data.x_.size() != this->ref_tree_.num_tips()) {
       throw std::invalid_argument("ERR:01201:SPLITT:ThreePointPOUMM.h:ThreePointPOUMM:: The vector x must be the same length as the number of tips.");
     } else {
 
-      uvec ordNodes = this->ref_tree_.OrderNodes(input_data.names_);
-      this->x = At(input_data.x_, ordNodes);
-      vec X(this->ref_tree_.num_tips());
-      this->set_X_and_Y(X, X);
-
-      // A root-to-node distance vector in the order of pruning processing
-      h.resize(this->ref_tree_.num_nodes());
-      std::fill(h.begin(), h.end(), 0.0);
-      
-      for(int i = this->ref_tree_.num_nodes() - 2; i >= 0; i--) {
-        h[i] = h[this->ref_tree_.FindIdOfParent(i)] + this->ref_tree_.LengthOfBranch(i);
-      }
+      this->x.resize(this->ref_tree_.num_tips());
+      input_data.CopyValuesInTipOrder(this->ref_tree_, this->x);
+      CalculateHeights();
+      InitWorkspace();
+    }
+  }
+
+  // Calculate h, T, u and sum_u from the branch lengths of the tree.
+  void CalculateHeights() {
+    // A root-to-node distance vector in the order of pruning processing
+    h.resize(this->ref_tree_.num_nodes());
+    std::fill(h.begin(), h.end(), 0.0);
+    
+    for(int i = this->ref_tree_.num_nodes() - 2; i >= 0; i--) {
+      h[i] = h[this->ref_tree_.FindIdOfParent(i)] + this->ref_tree_.LengthOfBranch(i);
+    }
+
+    this->T = *std::max_element(h.begin(), h.begin() + this->ref_tree_.num_tips());
+    
+    this->u.resize(this->ref_tree_.num_tips());
+    for(uint i = 0; i < this->ref_tree_.num_tips(); i++) {
+      u[i] = T - h[i];
+    }
+    sum_u = 0;
+    for(auto uu : u) sum_u += uu;
+  }
+
+  // A spec on tree sharing x, h, u, T and sum_u with other, a spec on the 
+  // same tree, e.g. for the workspaces of a TraversalTaskPool. The cache and
+  // the per-node state of the traversal are not shared. Modifying the shared
+  // quantities, e.g. by SetData or UpdateBranchLength, affects both specs.
+  ThreePointPOUMM(TreeType const& tree, ThreePointPOUMM const& other):
+    BaseType(tree),
+    data_derived_(other.data_derived_),
+    x(data_derived_->x), T(data_derived_->T), h(data_derived_->h),
+    u(data_derived_->u), sum_u(data_derived_->sum_u) {
+    InitWorkspace();
+  }
+
+  // Allocate the per-node state of the traversal and the cache.
+  void InitWorkspace() {
+    vec X(this->ref_tree_.num_tips());
+    this->set_X(X);
+    alpha_cached = std::numeric_limits<double>::quiet_NaN();
+    ealphahT.resize(this->ref_tree_.num_nodes());
+    tFactor.resize(this->ref_tree_.num_nodes() - 1);
+    eminusalphah.resize(this->ref_tree_.num_tips());
+  }
+
+  // Recalculate the exponentials in the cache for the current value of alpha.
+  // Each node's exponential is calculated once and reused for the branches
+  // leading to its children.
+  void UpdateCache() {
+    uint num_nodes = this->ref_tree_.num_nodes();
+    uint num_tips = this->ref_tree_.num_tips();
 
-      this->T = *std::max_element(h.begin(), h.begin() + this->ref_tree_.num_tips());
-      
-      this->u = SPLITT::vec(this->ref_tree_.num_tips());
-      for(int i = 0; i < this->ref_tree_.num_tips(); i++) {
-        u[i] = T - h[i];
+    this->e2alphaT = exp(-2*alpha*T);
+
+    _PRAGMA_OMP_SIMD
+    for(uint i = 0; i < num_nodes; i++) {
+      ealphahT[i] = alpha*(h[i] - T);
+    }
+    ExpVec(&ealphahT[0], &ealphahT[0], num_nodes);
+
+    for(uint i = 0; i < num_nodes - 1; i++) {
+      tFactor[i] = TFactor(i);
+    }
+
+    // exp(-alpha*h[i]) = exp(-alpha*T) / exp(-alpha*u[i])
+    Value eminusalphaT = exp(-alpha*T);
+    _PRAGMA_OMP_SIMD
+    for(uint i = 0; i < num_tips; i++) {
+      eminusalphah[i] = eminusalphaT / ealphahT[i];
+    }
+  }
+
+  // tFactor[i] given ealphahT[i] and ealphahT at the parent of i.
+  inline Value TFactor(uint i) const {
+    uint iParent = this->ref_tree_.FindIdOfParent(i);
+    if(alpha == 0) {
+      // limit of the expression below for alpha -> 0. The terms in alpha do
+      // not change the value but are needed for the derivatives with respect
+      // to alpha (up to the second) when Value is a dual number.
+      double a = h[i] - T, b = h[iParent] - T;
+      return (h[i] - h[iParent]) +
+        alpha * ((a*a - b*b) + alpha * (2.0/3.0) * (a*a*a - b*b*b));
+    } else {
+      Value ealphahTParent = ealphahT[iParent];
+      return (ealphahT[i]*ealphahT[i] - ealphahTParent*ealphahTParent) /
+        (2*alpha);
+    }
+  }
+
+  // Update h, u, sum_u and the cache after the length of the branch leading
+  // to node i has been changed in the tree. The tree height T is kept fixed
+  // (the log-likelihood does not depend on it, see
+  // BranchLengthGradientFromAdjoints). Returns the ids of the nodes in the
+  // subtree rooted at i, all of which change their height.
+  uvec UpdateBranchLength(uint i) {
+    uint num_tips = this->ref_tree_.num_tips();
+    uvec subtree(1, i);
+    // the parent of each node in the subtree is updated before the node.
+    for(uint k = 0; k < subtree.size(); k++) {
+      uint j = subtree[k];
+      h[j] = h[this->ref_tree_.FindIdOfParent(j)] + this->ref_tree_.LengthOfBranch(j);
+      if(j < num_tips) {
+        sum_u -= u[j];
+        u[j] = T - h[j];
+        sum_u += u[j];
+      } else {
+        uvec const& children = this->ref_tree_.FindChildren(j);
+        subtree.insert(subtree.end(), children.begin(), children.end());
+      }
+      if(!std::isnan(alpha_cached)) {
+        ealphahT[j] = exp(alpha*(h[j] - T));
+        tFactor[j] = TFactor(j);
+        if(j < num_tips) {
+          eminusalphah[j] = exp(-alpha*h[j]);
+        }
       }
-      sum_u = 0;
-      for(auto uu : u) sum_u += uu;
     }
+    return subtree;
+  }
+
+  // Set the trait value at tip i; only the transformed value X[i] depends on
+  // it (see TraversalTaskIncremental.h).
+  uvec UpdateTipValue(uint i, double value) {
+    x[i] = value;
+    return uvec(1, i);
+  }
+
+  // Update the per-node quantities after a tip with trait value value has
+  // been inserted in the tree with id i_tip (see OrderedTree::InsertTip).
+  // Returns the ids of the new tip, its parent and its sibling, whose 
+  // InitNode depends on the insertion.
+  uvec InsertTip(uint i_tip, double value) {
+    TreeType const& tree = this->ref_tree_;
+    BaseType::MoveStateAfterInsertTip();
+    tree.MoveValuesAfterInsertTip(h);
+    tree.MoveValuesAfterInsertTip(ealphahT);
+    tree.MoveValuesAfterInsertTip(tFactor, true);
+    x.push_back(value);
+    u.push_back(0);
+    eminusalphah.push_back(0);
+
+    uint i_node = tree.FindIdOfParent(i_tip);
+    uvec const& children = tree.FindChildren(i_node);
+    uint j = children[0] == i_tip? children[1]: children[0];
+
+    h[i_node] = h[tree.FindIdOfParent(i_node)] + tree.LengthOfBranch(i_node);
+    h[i_tip] = h[i_node] + tree.LengthOfBranch(i_tip);
+    u[i_tip] = T - h[i_tip];
+    sum_u += u[i_tip];
+    if(!std::isnan(alpha_cached)) {
+      ealphahT[i_node] = exp(alpha*(h[i_node] - T));
+      ealphahT[i_tip] = exp(alpha*(h[i_tip] - T));
+      eminusalphah[i_tip] = exp(-alpha*h[i_tip]);
+      tFactor[i_node] = TFactor(i_node);
+      tFactor[i_tip] = TFactor(i_tip);
+      tFactor[j] = TFactor(j);
+    }
+    return uvec({i_tip, i_node, j});
+  }
+
+  // Permute the per-node quantities after the tree has assigned new ids to
+  // its nodes; id_old[k] is the old id of the node with new id k (see
+  // OrderedTree::Reorder). The cache remains valid.
+  void PermuteNodes(uvec const& id_old) {
+    uint num_nodes = this->ref_tree_.num_nodes();
+    uint num_tips = this->ref_tree_.num_tips();
+    uvec id_old_tips(id_old.begin(), id_old.begin() + num_tips);
+    uvec id_old_branches(id_old.begin(), id_old.begin() + num_nodes - 1);
+    x = At(x, id_old_tips);
+    u = At(u, id_old_tips);
+    h = At(h, id_old);
+    if(!std::isnan(alpha_cached)) {
+      eminusalphah = At(eminusalphah, id_old_tips);
+      ealphahT = At(ealphahT, id_old);
+      tFactor = At(tFactor, id_old_branches);
+    }
+  }
+
+  // The values, besides the topology and the branch lengths of the subtree
+  // rooted at node i, on which the state of node i after VisitNode depends:
+  // the height of the node, the tree height and the trait value of a tip
+  // (see TraversalTaskTreeSet.h). Thus, the same clade has the same state in
+  // two trees only if it is at the same height in trees of the same height.
+  vec HashInputsOfNode(uint i) const {
+    if(i < this->ref_tree_.num_tips()) {
+      return vec({h[i], T, x[i]});
+    } else {
+      return vec({h[i], T});
+    }
+  }
+
+  // Replace the trait values at the tips, keeping the tree and all other
+  // per-node quantities.
+  void SetData(DataType const& input_data) {
+    input_data.CopyValuesInTipOrder(this->ref_tree_, this->x);
+  }
+
+  // Recalculate x, h, u, T and sum_u after the tree has been replaced by
+  // another tree with the same numbers of tips and nodes (see
+  // TraversalTaskTreeSet.h); x_tips are the trait values in the order of the
+  // tip ids of the new tree. The cache is invalidated.
+  void ReplaceTree(vec const& x_tips) {
+    std::copy(x_tips.begin(), x_tips.end(), x.begin());
+    CalculateHeights();
+    alpha_cached = std::numeric_limits<double>::quiet_NaN();
   }
 
   void SetParameter(ParameterType const& par) {
@@ -100,44 +324,157 @@ public:
     if(par[1] < 0 || par[3] < 0 || par[4] < 0) {
       throw std::logic_error("ERR:01212:SPLITT:ThreePointPOUMM.h:SetParameter:: The parameters alpha, sigma2 and sigmae2 should be non-negative.");
     }
-    this->x0 = par[0];
-    this->alpha = par[1];
-    this->theta = par[2];
-    this->sigma2 = par[3];
-    this->sigmae2 = par[4];
-    this->e2alphaT = exp(-2*alpha*T);
+    this->x0 = Variable<Value>::Create(par[0], 0);
+    this->alpha = Variable<Value>::Create(par[1], 1);
+    this->theta = Variable<Value>::Create(par[2], 2);
+    this->sigma2 = Variable<Value>::Create(par[3], 3);
+    this->sigmae2 = Variable<Value>::Create(par[4], 4);
+    if(par[1] != alpha_cached) {
+      UpdateCache();
+      alpha_cached = par[1];
+    }
   }
 
   inline void InitNode(uint i) {
-    ThreePointUnivariate<TreeType>::InitNode(i);
+    BaseType::InitNode(i);
     if(i < this->ref_tree_.num_nodes() - 1) {
       // if an internal node or a tip, transform the branch length leading to this tip
-      uint iParent = this->ref_tree_.FindIdOfParent(i);
-      
-      double ealphahi = exp(alpha*h[i]);
-
-      this->tTransf[i] = sigma2/(2*alpha) *
-        (e2alphaT*(ealphahi*ealphahi - exp((2*alpha)*h[iParent])));
+      Value t = sigma2 * tFactor[i];
 
       if(i < this->ref_tree_.num_tips()) {
-        double mu = theta + (x0 - theta) / ealphahi;
-        double ealphaui = exp(-alpha*u[i]);
-        this->X[i] = this->Y[i] = (x[i] - mu)*ealphaui;
-        this->tTransf[i] += sigmae2 * ealphaui*ealphaui;
+        Value mu = theta + (x0 - theta) * eminusalphah[i];
+        Value ealphaui = ealphahT[i];
+        this->X[i] = (x[i] - mu)*ealphaui;
+        t += sigmae2 * ealphaui*ealphaui;
       }
+      this->tTransf[i] = t;
     }
   }
 
+  // The log-likelihood; with dual number storage, followed by its
+  // derivatives with respect to x0, alpha, theta, sigma2 and sigmae2.
   inline StateType StateAtRoot() const {
-    vec res(1);
-    double lnDetVRoot = 2*alpha*sum_u + this->lnDetV[this->ref_tree_.num_nodes() - 1];
+    vec res;
+    Value lnDetVRoot = 2*alpha*sum_u + this->lnDetV[this->ref_tree_.num_nodes() - 1];
     // std::cout<<"lnDetVRoot: "<<lnDetVRoot<<std::endl;
     
-    double QRoot = this->Q[this->ref_tree_.num_nodes() - 1];
+    Value QRoot = this->Q[this->ref_tree_.num_nodes() - 1];
     // std::cout<<"QRoot: "<<QRoot<<std::endl;
-    res[0] = -0.5*(this->ref_tree_.num_tips() * log(2*G_PI)+ lnDetVRoot + QRoot);
+    Value ll = -0.5*(this->ref_tree_.num_tips() * log(2*G_PI)+ lnDetVRoot + QRoot);
+    AppendValue(res, ll);
+    return res;
+  }
+
+  // The log-likelihood of each component of a forest (see OrderedForest.h),
+  // calculated from the quantities at the component roots after a
+  // traversal. Requires an OrderedForest as TreeType.
+  std::vector<StateType> StatesAtComponentRoots() const {
+    uint num_components = this->ref_tree_.num_components();
+    uvec component = this->ref_tree_.FindComponentOfNodes();
+    uvec num_tips(num_components, 0);
+    vec sum_u_component(num_components, 0.0);
+    for(uint i = 0; i < this->ref_tree_.num_tips(); i++) {
+      num_tips[component[i]]++;
+      sum_u_component[component[i]] += u[i];
+    }
+    std::vector<StateType> res(num_components);
+    for(uint c = 0; c < num_components; c++) {
+      uint i = this->ref_tree_.FindIdOfComponentRoot(c);
+      Value lnDetVRoot = 2*alpha*sum_u_component[c] + this->lnDetV[i];
+      Value ll = -0.5*(num_tips[c] * log(2*G_PI) + lnDetVRoot + this->Q[i]);
+      AppendValue(res[c], ll);
+    }
     return res;
   }
+
+  // The gradient of the log-likelihood with respect to x0, alpha, theta,
+  // sigma2 and sigmae2, given the adjoints of tTransf and X calculated by a
+  // pre-order traversal after the last post-order traversal (see
+  // ThreePointUnivariateAdjoint.h). With dual number storage, the elements
+  // of the gradient carry their derivatives with respect to the parameters.
+  ValueVec GradientFromAdjoints(ValueVec const& adj_tTransf, ValueVec const& adj_X) const {
+    uint num_nodes = this->ref_tree_.num_nodes();
+    uint num_tips = this->ref_tree_.num_tips();
+
+    // the term -0.5*2*alpha*sum_u in lnDetVRoot
+    Value d_x0 = 0, d_alpha = -sum_u, d_theta = 0, d_sigma2 = 0, d_sigmae2 = 0;
+
+    for(uint i = 0; i < num_nodes - 1; i++) {
+      uint iParent = this->ref_tree_.FindIdOfParent(i);
+      double a = h[i] - T, b = h[iParent] - T;
+      // derivative of tFactor[i] with respect to alpha; for alpha = 0, the
+      // term in alpha is needed for the derivative with respect to alpha.
+      Value dtFactor;
+      if(alpha == 0) {
+        dtFactor = (a*a - b*b) + alpha * (4.0/3.0) * (a*a*a - b*b*b);
+      } else {
+        Value E = ealphahT[i]*ealphahT[i];
+        Value EParent = ealphahT[iParent]*ealphahT[iParent];
+        dtFactor = (a*E - b*EParent - tFactor[i]) / alpha;
+      }
+      d_sigma2 += adj_tTransf[i] * tFactor[i];
+      d_alpha += adj_tTransf[i] * sigma2 * dtFactor;
+    }
+
+    for(uint i = 0; i < num_tips; i++) {
+      Value w = ealphahT[i];
+      Value e = eminusalphah[i];
+      double a = h[i] - T;
+      Value mu = theta + (x0 - theta) * e;
+      // tTransf[i] += sigmae2*w^2
+      d_sigmae2 += adj_tTransf[i] * w*w;
+      d_alpha += adj_tTransf[i] * sigmae2 * 2*a*w*w;
+      // X[i] = (x[i] - mu)*w
+      d_x0 -= adj_X[i] * e*w;
+      d_theta -= adj_X[i] * (1 - e)*w;
+      d_alpha += adj_X[i] * ((x0 - theta)*h[i]*e*w + (x[i] - mu)*w*a);
+    }
+
+    ValueVec res(5);
+    res[0] = d_x0;
+    res[1] = d_alpha;
+    res[2] = d_theta;
+    res[3] = d_sigma2;
+    res[4] = d_sigmae2;
+    return res;
+  }
+
+  // The gradient of the log-likelihood with respect to the length of the
+  // branch leading to each node (in the order of the node ids), given the
+  // adjoints of tTransf and X (see GradientFromAdjoints). The log-likelihood
+  // does not depend on the tree height T, which only scales the quantities in
+  // the cache. Thus, with T fixed, the length of a branch enters the
+  // log-likelihood through the heights h of all nodes in the subtree below
+  // it, and its partial derivative is the sum of the partial derivatives with
+  // respect to these heights.
+  ValueVec BranchLengthGradientFromAdjoints(ValueVec const& adj_tTransf, ValueVec const& adj_X) const {
+    uint num_nodes = this->ref_tree_.num_nodes();
+    uint num_tips = this->ref_tree_.num_tips();
+
+    // partial derivatives with respect to the node heights
+    ValueVec g(num_nodes, 0);
+    for(uint i = 0; i < num_nodes - 1; i++) {
+      uint iParent = this->ref_tree_.FindIdOfParent(i);
+      // d tFactor[i] / d h[i] = exp(2*alpha*(h[i] - T)) and
+      // d tFactor[i] / d h[iParent] = -exp(2*alpha*(h[iParent] - T)).
+      g[i] += adj_tTransf[i] * sigma2 * ealphahT[i] * ealphahT[i];
+      g[iParent] -= adj_tTransf[i] * sigma2 * ealphahT[iParent] * ealphahT[iParent];
+    }
+    for(uint i = 0; i < num_tips; i++) {
+      Value w = ealphahT[i];
+      // tTransf[i] += sigmae2*w^2, X[i] = (x[i] - theta)*w - (x0 - theta)*exp(-alpha*T)
+      // and the term alpha*u[i] in -0.5*lnDetVRoot.
+      g[i] += adj_tTransf[i] * sigmae2 * 2*alpha*w*w +
+        adj_X[i] * alpha*(x[i] - theta)*w + alpha;
+    }
+
+    // sums over the subtrees: the children of a node have smaller ids.
+    for(uint i = 0; i < num_nodes - 1; i++) {
+      g[this->ref_tree_.FindIdOfParent(i)] += g[i];
+    }
+    g.resize(num_nodes - 1);
+    return g;
+  }
 };
 
 }
@@ -0,0 +1,205 @@
+/*
+ *  ThreePointPOUMMProfile.h
+ *  SPLITT
+ *
+ * Copyright 2017 Venelin Mitov
+ *
+ * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+ * Lineage Traversal of Trees.
+ *
+ * SPLITT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SPLITT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SPLITT.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * @author Venelin Mitov
+ */
+
+#ifndef ThreePointPOUMMProfile_H_
+#define ThreePointPOUMMProfile_H_
+
+#include "ThreePointUnivariateMultiColumn.h"
+#include "NumericTraitData.h"
+#include <algorithm>
+#include <limits>
+
+using namespace SPLITT;
+
+namespace ThreePointUsingSPLITT {
+
+// POUMM log-likelihood profiled over x0 and theta.
+//
+// For fixed alpha, sigma2 and sigmae2 the transformed tip values used by
+// ThreePointPOUMM are an affine function of (x0, theta):
+// (x[i] - mu[i])*w[i] = x[i]*w[i] - x0*a[i] - theta*b[i], where
+// w[i] = exp(-alpha*u[i]), a[i] = w[i]*exp(-alpha*h[i]) and b[i] = w[i] - a[i].
+// Thus, the quadratic form in the log-likelihood is a quadratic polynomial in
+// (x0, theta) with coefficients given by the cross-products of the columns
+// (x*w, a, b). These are calculated in a single traversal. After that, the
+// maximum likelihood estimates of x0 and theta, as well as the log-likelihood
+// at any point (x0, theta), are calculated in constant time.
+template<class Tree>
+class ThreePointPOUMMProfile: public ThreePointUnivariateMultiColumn<Tree> {
+
+public:
+  typedef ThreePointPOUMMProfile<Tree> MyType;
+  typedef Tree TreeType;
+  typedef PostOrderTraversal<MyType> AlgorithmType;
+  typedef ThreePointUnivariateMultiColumn<TreeType> BaseType;
+  typedef vec ParameterType;
+  typedef NumericTraitData<typename TreeType::NodeType> DataType;
+  typedef vec StateType;
+
+  // univariate trait vector
+  SPLITT::vec x;
+
+  // tree height (maximum root-tip distance)
+  double T;
+  // h: height (distance from the root) for each node in the tree
+  SPLITT::vec h;
+  // u: distance from the far-most tip for each node (, i.e. u[i] = T - h[i])
+  SPLITT::vec u;
+
+  double alpha, sigma2, sigmae2, e2alphaT, sum_u;
+
+  ThreePointPOUMMProfile(
+    TreeType const& tree, DataType const& input_data):
+    BaseType(tree) {
+
+    if(input_data.x_.size() != this->ref_tree_.num_tips()) {
+      throw std::invalid_argument("ERR:01221:SPLITT:ThreePointPOUMMProfile.h:ThreePointPOUMMProfile:: The vector x must be the same length as the number of tips.");
+    } else {
+
+      this->x.resize(this->ref_tree_.num_tips());
+      input_data.CopyValuesInTipOrder(this->ref_tree_, this->x);
+      // three columns: x*w, a and b.
+      this->set_X(vec(3 * this->ref_tree_.num_tips()), 3);
+
+      // A root-to-node distance vector in the order of pruning processing
+      h.resize(this->ref_tree_.num_nodes());
+      std::fill(h.begin(), h.end(), 0.0);
+
+      for(int i = this->ref_tree_.num_nodes() - 2; i >= 0; i--) {
+        h[i] = h[this->ref_tree_.FindIdOfParent(i)] + this->ref_tree_.LengthOfBranch(i);
+      }
+
+      this->T = *std::max_element(h.begin(), h.begin() + this->ref_tree_.num_tips());
+
+      this->u = SPLITT::vec(this->ref_tree_.num_tips());
+      for(uint i = 0; i < this->ref_tree_.num_tips(); i++) {
+        u[i] = T - h[i];
+      }
+      sum_u = 0;
+      for(auto uu : u) sum_u += uu;
+    }
+  }
+
+  void SetParameter(ParameterType const& par) {
+    if(par.size() != 3) {
+      throw std::invalid_argument(
+          "ERR:01222:SPLITT:ThreePointPOUMMProfile.h:SetParameter:: The par vector should be of length 3 with \
+      elements corresponding to alpha, sigma2 and sigmae2.");
+    }
+    if(par[0] < 0 || par[1] < 0 || par[2] < 0) {
+      throw std::logic_error("ERR:01223:SPLITT:ThreePointPOUMMProfile.h:SetParameter:: The parameters alpha, sigma2 and sigmae2 should be non-negative.");
+    }
+    this->alpha = par[0];
+    this->sigma2 = par[1];
+    this->sigmae2 = par[2];
+    this->e2alphaT = exp(-2*alpha*T);
+  }
+
+  inline void InitNode(uint i) {
+    BaseType::InitNode(i);
+    if(i < this->ref_tree_.num_nodes() - 1) {
+      // if an internal node or a tip, transform the branch length leading to this tip
+      uint iParent = this->ref_tree_.FindIdOfParent(i);
+
+      double ealphahi = exp(alpha*h[i]);
+
+      if(alpha == 0) {
+        // limit of the expression below for alpha -> 0.
+        this->tTransf[i] = sigma2 * (h[i] - h[iParent]);
+      } else {
+        this->tTransf[i] = sigma2/(2*alpha) *
+          (e2alphaT*(ealphahi*ealphahi - exp((2*alpha)*h[iParent])));
+      }
+
+      if(i < this->ref_tree_.num_tips()) {
+        double ealphaui = exp(-alpha*u[i]);
+        this->X[3*i] = x[i]*ealphaui;
+        this->X[3*i + 1] = ealphaui / ealphahi;
+        this->X[3*i + 2] = ealphaui - ealphaui / ealphahi;
+        this->tTransf[i] += sigmae2 * ealphaui*ealphaui;
+      }
+    }
+  }
+
+  // The quadratic form (z - x0*a - theta*b)'V^(-1)(z - x0*a - theta*b).
+  // Must be called after a traversal of the tree.
+  double QuadraticForm(double x0, double theta) const {
+    double const* Q = &this->Q[(this->ref_tree_.num_nodes() - 1) * this->kk];
+    // packed lower triangle: zz, az, aa, bz, ba, bb
+    return Q[0] + x0*x0*Q[2] + theta*theta*Q[5] -
+      2*x0*Q[1] - 2*theta*Q[3] + 2*x0*theta*Q[4];
+  }
+
+  // The POUMM log-likelihood at (x0, theta) for the alpha, sigma2 and sigmae2
+  // of the last traversal.
+  double LogLik(double x0, double theta) const {
+    double lnDetVRoot = 2*alpha*sum_u + this->lnDetV[this->ref_tree_.num_nodes() - 1];
+    return -0.5*(this->ref_tree_.num_tips() * log(2*G_PI) + lnDetVRoot +
+                 QuadraticForm(x0, theta));
+  }
+
+  // The log-likelihood at all combinations of the elements in x0 and theta,
+  // returned in column-major order with x0 changing fastest.
+  vec LogLikGrid(vec const& x0, vec const& theta) const {
+    vec res(x0.size() * theta.size());
+    for(uint jt = 0; jt < theta.size(); jt++) {
+      for(uint jx = 0; jx < x0.size(); jx++) {
+        res[jt*x0.size() + jx] = LogLik(x0[jx], theta[jt]);
+      }
+    }
+    return res;
+  }
+
+  // A vector containing the profile log-likelihood and the maximum likelihood
+  // estimates of x0 and theta. If one of x0 and theta is not identifiable (e.g.
+  // theta for alpha = 0), its estimate is NaN and the log-likelihood is
+  // profiled over the other one only.
+  inline StateType StateAtRoot() const {
+    double const* Q = &this->Q[(this->ref_tree_.num_nodes() - 1) * this->kk];
+    double x0_hat, theta_hat;
+    double det = Q[2]*Q[5] - Q[4]*Q[4];
+    if(Q[5] == 0) {
+      x0_hat = Q[1] / Q[2];
+      theta_hat = std::numeric_limits<double>::quiet_NaN();
+    } else if(Q[2] == 0) {
+      x0_hat = std::numeric_limits<double>::quiet_NaN();
+      theta_hat = Q[3] / Q[5];
+    } else {
+      x0_hat = (Q[5]*Q[1] - Q[4]*Q[3]) / det;
+      theta_hat = (Q[2]*Q[3] - Q[4]*Q[1]) / det;
+    }
+
+    vec res(3);
+    res[0] = LogLik(std::isnan(x0_hat)? 0: x0_hat,
+                    std::isnan(theta_hat)? 0: theta_hat);
+    res[1] = x0_hat;
+    res[2] = theta_hat;
+    return res;
+  }
+};
+
+}
+#endif // ThreePointPOUMMProfile_H_
@@ -27,6 +27,7 @@
 #define ParallelPruning_ThreePointUnivariate_H_
 
 #include "./SPLITT.h"
+#include "./DualNumber.h"
 
 using namespace SPLITT;
 // Calculate the |V| and quadratic quantities of the form Q=X'V^(-1)Y, for
@@ -40,7 +41,24 @@ using namespace SPLITT;
 //
 // Reference: Lam Si Tung Ho and Cécile Ané. A Linear-Time Algorithm for
 // Gaussian and Non-Gaussian Trait Evolution Models. SysBiol 2014.
-template<class Tree>
+//
+// Storage is the scalar type used to store the per-node quantities X, Y,
+// tTransf, hat{mu}, tilde{mu} and p (double, float or a DualNumber). The
+// arithmetic and the quantities lnDetV and Q, which are summed over all
+// nodes, use the type Value = ValueTypeOf<Storage>::Type, i.e. double for
+// double and float storage. With a DualNumber, the derivatives of lnDetV and
+// Q are propagated through the traversal. The children of an internal node are
+// summed in PruneNode into ChildSums, which VisitNode normalizes; for float
+// storage these are side accumulators of type Value, rounded to Storage once,
+// otherwise the sums are kept in place in the stored vectors. With float storage, the memory traffic of the traversal is
+// nearly halved at the cost of a relative error of about 2^-24 in each stored
+// value. For trees of N tips with branch lengths and
+// data of order 1, the absolute error in lnDetV+Q at the root stays below
+// 1e-7*N; on random trees we have observed errors of about 1e-5 for N = 10^3
+// and 4e-4 for N = 2*10^6 (see BenchmarkStoragePrecision in the R-package).
+// Use float storage only when this error is negligible for the application,
+// e.g. for MCMC proposals, but not for numerical optimization.
+template<class Tree, class Storage = double>
 class ThreePointUnivariate: public TraversalSpecification<Tree> {
 
 public:
@@ -48,69 +66,244 @@ public:
   typedef Tree TreeType;
   typedef vec StateType;
   typedef vec ParameterType;
+  typedef std::vector<Storage> StorageVec;
+  typedef typename ThreePointUsingSPLITT::ValueTypeOf<Storage>::Type Value;
+  typedef std::vector<Value> ValueVec;
 
   // public (unsafe) access to fields.
-  vec X, Y;
-  vec tTransf;
-  vec hat_mu_Y, tilde_mu_X_prime;
-  vec lnDetV, p, Q;
+  StorageVec X, Y;
+  StorageVec tTransf;
+  StorageVec hat_mu_Y, tilde_mu_X_prime;
+  StorageVec p;
+  ValueVec lnDetV, Q;
+  // sum_hat_mu_Y(hat_mu_Y, i, num_tips), sum_tilde_mu_X_prime(tilde_mu_X_prime,
+  // i, num_tips) and sum_p(p, i, num_tips) accumulate the children of internal
+  // node i in PruneNode, before VisitNode(i) normalizes them.
+  ThreePointUsingSPLITT::ChildSums<Storage, Value> sum_hat_mu_Y, sum_tilde_mu_X_prime, sum_p;
 
   ThreePointUnivariate(Tree const& tree): BaseType(tree) {
-    this->tTransf = vec(this->ref_tree_.num_nodes() - 1);
-    this->lnDetV = vec(this->ref_tree_.num_nodes(), 0);
-    this->p = vec(this->ref_tree_.num_nodes(), 0);
-    this->Q = vec(this->ref_tree_.num_nodes(), 0);
+    this->tTransf = StorageVec(this->ref_tree_.num_nodes() - 1);
+    this->lnDetV = ValueVec(this->ref_tree_.num_nodes(), 0);
+    this->p = StorageVec(this->ref_tree_.num_nodes(), 0);
+    this->Q = ValueVec(this->ref_tree_.num_nodes(), 0);
+    this->sum_hat_mu_Y.Resize(this->ref_tree_.num_tips(), this->ref_tree_.num_nodes());
+    this->sum_tilde_mu_X_prime.Resize(this->ref_tree_.num_tips(), this->ref_tree_.num_nodes());
+    this->sum_p.Resize(this->ref_tree_.num_tips(), this->ref_tree_.num_nodes());
   };
 
   void set_X_and_Y(vec const& X, vec const& Y) {
     if(X.size() != this->ref_tree_.num_tips() || Y.size() != this->ref_tree_.num_tips()) {
       throw std::invalid_argument("ERR:01101:SPLITT:ThreePointUnivariate.h:Set_X_and_Y:: The matrices X and Y must have the same number of rows as V.");
     } else {
-      this->X = X; this->Y = Y;
+      this->X = StorageVec(X.begin(), X.end());
+      this->Y = StorageVec(Y.begin(), Y.end());
 
-      this->hat_mu_Y = vec(this->ref_tree_.num_nodes(), 0);
-      this->tilde_mu_X_prime = vec(this->ref_tree_.num_nodes(), 0);
+      this->hat_mu_Y = StorageVec(this->ref_tree_.num_nodes(), 0);
+      this->tilde_mu_X_prime = StorageVec(this->ref_tree_.num_nodes(), 0);
     }
   }
 
   StateType StateAtRoot() const {
-    vec res(2);
-    res[0] = this->lnDetV[this->ref_tree_.num_nodes() - 1];
-    res[1] = this->Q[this->ref_tree_.num_nodes() - 1];
+    vec res;
+    ThreePointUsingSPLITT::AppendValue(res, this->lnDetV[this->ref_tree_.num_nodes() - 1]);
+    ThreePointUsingSPLITT::AppendValue(res, this->Q[this->ref_tree_.num_nodes() - 1]);
     return res;
   }
 
   inline void InitNode(uint i) {
-    tTransf[i] = this->ref_tree_.LengthOfBranch(i);
-    hat_mu_Y[i] = tilde_mu_X_prime[i] = lnDetV[i] = p[i] = Q[i] = 0;
+    if(i < this->ref_tree_.num_nodes() - 1) {
+      // there is no branch leading to the root
+      tTransf[i] = this->ref_tree_.LengthOfBranch(i);
+    }
+    lnDetV[i] = Q[i] = 0;
+    uint num_tips = this->ref_tree_.num_tips();
+    if(i >= num_tips) {
+      sum_hat_mu_Y(hat_mu_Y, i, num_tips) = 0;
+      sum_tilde_mu_X_prime(tilde_mu_X_prime, i, num_tips) = 0;
+      sum_p(p, i, num_tips) = 0;
+    }
   }
 
   inline void VisitNode(uint i) {
+    Value t = tTransf[i];
     if(i < this->ref_tree_.num_tips()) {
       // branch leading to a tip
-      lnDetV[i] = log(tTransf[i]);
-      p[i] = 1 / tTransf[i];
+      lnDetV[i] = log(t);
+      p[i] = 1 / t;
       hat_mu_Y[i] = Y[i];
       tilde_mu_X_prime[i] = X[i];
-      Q[i] = X[i] * Y[i] / tTransf[i];
+      Q[i] = Value(X[i]) * Value(Y[i]) / t;
     } else {
-      hat_mu_Y[i] /= p[i];
-      tilde_mu_X_prime[i] /= p[i];
-      Q[i] -= tTransf[i]*p[i]*p[i] / (1 + tTransf[i]*p[i]) *
-        tilde_mu_X_prime[i] * hat_mu_Y[i];
-      lnDetV[i] += log(1 + tTransf[i]*p[i]);
-      p[i] /= (1 + tTransf[i]*p[i]);
+      uint num_tips = this->ref_tree_.num_tips();
+      Value pi = sum_p(p, i, num_tips);
+      Value mu_Y = sum_hat_mu_Y(hat_mu_Y, i, num_tips) / pi;
+      Value mu_X = sum_tilde_mu_X_prime(tilde_mu_X_prime, i, num_tips) / pi;
+      hat_mu_Y[i] = mu_Y;
+      tilde_mu_X_prime[i] = mu_X;
+      Q[i] -= t*pi*pi / (1 + t*pi) * mu_X * mu_Y;
+      lnDetV[i] += log(1 + t*pi);
+      p[i] = pi / (1 + t*pi);
     }
   }
 
+  // The state of node i after its VisitNode. It depends only on the subtree
+  // rooted at i and the branch leading to i, which it summarises for the
+  // parent of i (see TraversalTaskTreeSet.h).
+  struct NodeState {
+    Storage hat_mu_Y, tilde_mu_X_prime, p;
+    Value lnDetV, Q;
+  };
+
+  NodeState StateOfNode(uint i) const {
+    return NodeState{hat_mu_Y[i], tilde_mu_X_prime[i], p[i], lnDetV[i], Q[i]};
+  }
+
+  void SetStateOfNode(uint i, NodeState const& state) {
+    hat_mu_Y[i] = state.hat_mu_Y;
+    tilde_mu_X_prime[i] = state.tilde_mu_X_prime;
+    p[i] = state.p;
+    lnDetV[i] = state.lnDetV;
+    Q[i] = state.Q;
+  }
+
   inline void PruneNode(uint i, uint i_parent) {
-    hat_mu_Y[i_parent] += p[i]*hat_mu_Y[i];
-    tilde_mu_X_prime[i_parent] += p[i]*tilde_mu_X_prime[i];
+    uint num_tips = this->ref_tree_.num_tips();
+    Value pi = p[i];
+    sum_hat_mu_Y(hat_mu_Y, i_parent, num_tips) += pi*Value(hat_mu_Y[i]);
+    sum_tilde_mu_X_prime(tilde_mu_X_prime, i_parent, num_tips) += pi*Value(tilde_mu_X_prime[i]);
     lnDetV[i_parent] += lnDetV[i];
-    p[i_parent] += p[i];
+    sum_p(p, i_parent, num_tips) += pi;
     Q[i_parent] += Q[i];
   }
 };
 
 
+// Specialisation of ThreePointUnivariate for the symmetric quadratic form
+// Q=X'V^(-1)X, i.e. X == Y. Each of the vectors X and hat{mu}_X=1'V^(-1)X/p
+// is stored once, which reduces the per-node state and the memory traffic
+// during the traversal. At the root, which is not visited, sum_hat_mu and sum_p
+// hold 1'V^(-1)X and 1'V^(-1)1.
+// Storage has the same meaning as in ThreePointUnivariate.
+template<class Tree, class Storage = double>
+class ThreePointUnivariateSymmetric: public TraversalSpecification<Tree> {
+
+public:
+  typedef TraversalSpecification<Tree> BaseType;
+  typedef Tree TreeType;
+  typedef vec StateType;
+  typedef vec ParameterType;
+  typedef std::vector<Storage> StorageVec;
+  typedef typename ThreePointUsingSPLITT::ValueTypeOf<Storage>::Type Value;
+  typedef std::vector<Value> ValueVec;
+
+  // public (unsafe) access to fields.
+  StorageVec X;
+  StorageVec tTransf;
+  StorageVec hat_mu;
+  StorageVec p;
+  ValueVec lnDetV, Q;
+  // sum_hat_mu(hat_mu, i, num_tips) and sum_p(p, i, num_tips) accumulate the
+  // children of internal node i in PruneNode (see ThreePointUnivariate).
+  ThreePointUsingSPLITT::ChildSums<Storage, Value> sum_hat_mu, sum_p;
+
+  ThreePointUnivariateSymmetric(Tree const& tree): BaseType(tree) {
+    this->tTransf = StorageVec(this->ref_tree_.num_nodes() - 1);
+    this->lnDetV = ValueVec(this->ref_tree_.num_nodes(), 0);
+    this->p = StorageVec(this->ref_tree_.num_nodes(), 0);
+    this->Q = ValueVec(this->ref_tree_.num_nodes(), 0);
+    this->sum_hat_mu.Resize(this->ref_tree_.num_tips(), this->ref_tree_.num_nodes());
+    this->sum_p.Resize(this->ref_tree_.num_tips(), this->ref_tree_.num_nodes());
+  };
+
+  void set_X(vec const& X) {
+    if(X.size() != this->ref_tree_.num_tips()) {
+      throw std::invalid_argument("ERR:01102:SPLITT:ThreePointUnivariate.h:set_X:: The vector X must have the same number of rows as V.");
+    } else {
+      this->X = StorageVec(X.begin(), X.end());
+      this->hat_mu = StorageVec(this->ref_tree_.num_nodes(), 0);
+    }
+  }
+
+  // Grow the per-node vectors after a tip has been inserted in the tree,
+  // keeping the state of the existing nodes (see OrderedTree::InsertTip).
+  void MoveStateAfterInsertTip() {
+    X.push_back(Storage(0));
+    this->ref_tree_.MoveValuesAfterInsertTip(tTransf, true);
+    this->ref_tree_.MoveValuesAfterInsertTip(hat_mu);
+    this->ref_tree_.MoveValuesAfterInsertTip(p);
+    this->ref_tree_.MoveValuesAfterInsertTip(lnDetV);
+    this->ref_tree_.MoveValuesAfterInsertTip(Q);
+    // the accumulators of the internal nodes are reset in InitNode
+    sum_hat_mu.AddInternalNode();
+    sum_p.AddInternalNode();
+  }
+
+  StateType StateAtRoot() const {
+    vec res;
+    ThreePointUsingSPLITT::AppendValue(res, this->lnDetV[this->ref_tree_.num_nodes() - 1]);
+    ThreePointUsingSPLITT::AppendValue(res, this->Q[this->ref_tree_.num_nodes() - 1]);
+    return res;
+  }
+
+  inline void InitNode(uint i) {
+    if(i < this->ref_tree_.num_nodes() - 1) {
+      // there is no branch leading to the root
+      tTransf[i] = this->ref_tree_.LengthOfBranch(i);
+    }
+    lnDetV[i] = Q[i] = 0;
+    uint num_tips = this->ref_tree_.num_tips();
+    if(i >= num_tips) {
+      sum_hat_mu(hat_mu, i, num_tips) = 0;
+      sum_p(p, i, num_tips) = 0;
+    }
+  }
+
+  inline void VisitNode(uint i) {
+    Value t = tTransf[i];
+    if(i < this->ref_tree_.num_tips()) {
+      // branch leading to a tip
+      Value x = X[i];
+      lnDetV[i] = log(t);
+      p[i] = 1 / t;
+      hat_mu[i] = x;
+      Q[i] = x * x / t;
+    } else {
+      uint num_tips = this->ref_tree_.num_tips();
+      Value pi = sum_p(p, i, num_tips);
+      Value mu = sum_hat_mu(hat_mu, i, num_tips) / pi;
+      hat_mu[i] = mu;
+      Q[i] -= t*pi*pi / (1 + t*pi) * mu * mu;
+      lnDetV[i] += log(1 + t*pi);
+      p[i] = pi / (1 + t*pi);
+    }
+  }
+
+  // The state of node i after its VisitNode (see
+  // ThreePointUnivariate::NodeState).
+  struct NodeState {
+    Storage hat_mu, p;
+    Value lnDetV, Q;
+  };
+
+  NodeState StateOfNode(uint i) const {
+    return NodeState{hat_mu[i], p[i], lnDetV[i], Q[i]};
+  }
+
+  void SetStateOfNode(uint i, NodeState const& state) {
+    hat_mu[i] = state.hat_mu;
+    p[i] = state.p;
+    lnDetV[i] = state.lnDetV;
+    Q[i] = state.Q;
+  }
+
+  inline void PruneNode(uint i, uint i_parent) {
+    uint num_tips = this->ref_tree_.num_tips();
+    Value pi = p[i];
+    sum_hat_mu(hat_mu, i_parent, num_tips) += pi*Value(hat_mu[i]);
+    lnDetV[i_parent] += lnDetV[i];
+    sum_p(p, i_parent, num_tips) += pi;
+    Q[i_parent] += Q[i];
+  }
+};
+
 #endif // ParallelPruning_ThreePointUnivariate_H_
@@ -0,0 +1,283 @@
+/*
+ *  ThreePointUnivariateAdjoint.h
+ *  SPLITT
+ *
+ * Copyright 2018 Venelin Mitov
+ *
+ * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+ * Lineage Traversal of Trees.
+ *
+ * SPLITT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SPLITT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SPLITT.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * @author Venelin Mitov
+ */
+#ifndef ParallelPruning_ThreePointUnivariateAdjoint_H_
+#define ParallelPruning_ThreePointUnivariateAdjoint_H_
+
+#include "./SPLITT.h"
+#include "./ThreePointUnivariate.h"
+
+using namespace SPLITT;
+
+// Reverse-mode (adjoint) differentiation of the symmetric 3-point recursion
+// (ThreePointUnivariateSymmetric with double or dual number storage).
+//
+// After pruning its children, an internal node i has the sums
+// L = sum lnDetV, P = sum p, H = sum p*hat_mu and Q0 = sum Q over its
+// daughters. With t = tTransf[i] and D = 1 + t*P, the visit produces
+// lnDetV = L + log(D), p = P/D, p*hat_mu = H/D and Q = Q0 - t*H^2/D, which are
+// added to the sums of the parent. A tip produces lnDetV = log(t), p = 1/t,
+// p*hat_mu = X/t and Q = X^2/t. Going from the root towards the tips, the
+// adjoints of the sums at the parent of a node are propagated through these
+// expressions to the adjoints of the sums at the node, to the adjoint of
+// tTransf[i] and, for a tip, to the adjoint of X[i]. The adjoints of L and Q0
+// are the same at all nodes, because these sums enter the parent sums
+// linearly.
+//
+// The forward quantities P and H are overwritten during the visit of a node.
+// ThreePointUnivariateRecording records them before each visit.
+//
+// All adjoints have the type Value of the forward spec. With a
+// DualNumber<D> Value, the adjoints carry their derivatives with respect to
+// the D parameters seeded in the forward traversal (forward over reverse
+// differentiation), so that the derivatives of the gradient, i.e. the
+// Hessian, are obtained in the same two traversals.
+template<class Spec>
+class ThreePointUnivariateRecording: public Spec {
+public:
+  typedef ThreePointUnivariateRecording<Spec> MyType;
+  typedef typename Spec::TreeType TreeType;
+  typedef PostOrderTraversal<MyType> AlgorithmType;
+  typedef typename Spec::DataType DataType;
+  typedef typename Spec::Value Value;
+  typedef typename Spec::ValueVec ValueVec;
+
+  // p_pruned[i] and hat_mu_pruned[i] are P and H at internal node i.
+  ValueVec p_pruned, hat_mu_pruned;
+
+  ThreePointUnivariateRecording(TreeType const& tree, DataType const& input_data):
+    Spec(tree, input_data),
+    p_pruned(tree.num_nodes(), 0),
+    hat_mu_pruned(tree.num_nodes(), 0) {}
+
+  inline void VisitNode(uint i) {
+    uint num_tips = this->ref_tree_.num_tips();
+    if(i >= num_tips) {
+      p_pruned[i] = this->sum_p(this->p, i, num_tips);
+      hat_mu_pruned[i] = this->sum_hat_mu(this->hat_mu, i, num_tips);
+    }
+    Spec::VisitNode(i);
+  }
+};
+
+// The pre-order traversal specification propagating the adjoints. The
+// parameter is the vector of the adjoints of lnDetV and Q at the root, i.e.
+// the partial derivatives of the log-likelihood with respect to these.
+template<class RecordingSpec>
+class ThreePointUnivariateAdjoint:
+  public TraversalSpecification<typename RecordingSpec::TreeType> {
+
+public:
+  typedef ThreePointUnivariateAdjoint<RecordingSpec> MyType;
+  typedef typename RecordingSpec::TreeType TreeType;
+  typedef TraversalSpecification<TreeType> BaseType;
+  typedef PreOrderTraversal<MyType> AlgorithmType;
+  typedef RecordingSpec DataType;
+  typedef vec ParameterType;
+  typedef vec StateType;
+  typedef typename RecordingSpec::Value Value;
+  typedef typename RecordingSpec::ValueVec ValueVec;
+
+  RecordingSpec const& ref_forward_;
+
+  double adj_lnDetV, adj_Q;
+  // adjoints of the sums P and H at each node.
+  ValueVec adj_p, adj_hat_mu;
+  // adjoint of tTransf[i] for each node except the root.
+  ValueVec adj_tTransf;
+  // adjoint of X[i] for each tip.
+  ValueVec adj_X;
+
+  ThreePointUnivariateAdjoint(TreeType const& tree, RecordingSpec const& forward):
+    BaseType(tree), ref_forward_(forward),
+    adj_lnDetV(0), adj_Q(0),
+    adj_p(tree.num_nodes(), 0), adj_hat_mu(tree.num_nodes(), 0),
+    adj_tTransf(tree.num_nodes() - 1, 0), adj_X(tree.num_tips(), 0) {}
+
+  void SetParameter(ParameterType const& par) {
+    if(par.size() != 2) {
+      throw std::invalid_argument(
+          "ERR:01121:SPLITT:ThreePointUnivariateAdjoint.h:SetParameter:: The par vector should be of length 2 with \
+      elements corresponding to the adjoints of lnDetV and Q at the root.");
+    }
+    adj_lnDetV = par[0];
+    adj_Q = par[1];
+  }
+
+  inline void InitNode(uint /*i*/) {}
+
+  inline void VisitNode(uint i) {
+    if(i == this->ref_tree_.num_nodes() - 1) {
+      // the log-likelihood does not depend on P and H at the root.
+      adj_p[i] = adj_hat_mu[i] = 0;
+      return;
+    }
+    uint i_parent = this->ref_tree_.FindIdOfParent(i);
+    Value gp = adj_p[i_parent];
+    Value gm = adj_hat_mu[i_parent];
+    Value t = ref_forward_.tTransf[i];
+
+    if(i < this->ref_tree_.num_tips()) {
+      Value x = ref_forward_.X[i];
+      Value inv_t = 1 / t;
+      adj_tTransf[i] = (adj_lnDetV - (gp + gm*x + adj_Q*x*x)*inv_t)*inv_t;
+      adj_X[i] = (gm + 2*adj_Q*x)*inv_t;
+    } else {
+      Value P = ref_forward_.p_pruned[i];
+      Value H = ref_forward_.hat_mu_pruned[i];
+      Value inv_D = 1 / (1 + t*P);
+      // H/D and P/D
+      Value HD = H*inv_D;
+      Value PD = P*inv_D;
+      adj_tTransf[i] = adj_lnDetV*PD - gp*PD*PD - gm*HD*PD - adj_Q*HD*HD;
+      adj_p[i] = adj_lnDetV*t*inv_D + gp*inv_D*inv_D - gm*HD*t*inv_D + adj_Q*t*t*HD*HD;
+      adj_hat_mu[i] = (gm - 2*adj_Q*t*H) * inv_D;
+    }
+  }
+
+  StateType StateAtRoot() const {
+    vec res;
+    for(auto const& a: adj_tTransf) ThreePointUsingSPLITT::AppendValue(res, a);
+    return res;
+  }
+};
+
+// A task calculating the log-likelihood and its gradient with respect to the
+// model parameters or to the branch lengths in one post-order and one
+// pre-order traversal, independent of the number of parameters or branches.
+// Spec must be a ThreePointUnivariateSymmetric with a log-likelihood of the
+// form const - 0.5*(lnDetV + Q) at the root, and implement the methods
+// GradientFromAdjoints(adj_tTransf, adj_X) and
+// BranchLengthGradientFromAdjoints(adj_tTransf, adj_X), returning the
+// gradient of the log-likelihood with respect to its parameters and with
+// respect to the length of the branch leading to each node (in the order of
+// the node ids) respectively.
+//
+// With double storage, the returned vectors contain the log-likelihood
+// followed by the gradient. With DualNumber<D> storage, they contain the
+// log-likelihood, its D first derivatives calculated in the forward
+// traversal, and the derivatives of each element of the gradient with
+// respect to the D parameters, i.e. for the parameter gradient, the Hessian
+// in row-major order.
+template<class Spec>
+class TraversalTaskAdjoint {
+public:
+  typedef ThreePointUnivariateRecording<Spec> TraversalSpecificationType;
+  typedef typename TraversalSpecificationType::TreeType TreeType;
+  typedef typename TraversalSpecificationType::AlgorithmType AlgorithmType;
+  typedef typename AlgorithmType::ModeType ModeType;
+  typedef ThreePointUnivariateAdjoint<TraversalSpecificationType> AdjointSpecificationType;
+  typedef typename AdjointSpecificationType::AlgorithmType AdjointAlgorithmType;
+  typedef typename AdjointAlgorithmType::ModeType AdjointModeType;
+  typedef typename TreeType::NodeType NodeType;
+  typedef typename TreeType::LengthType LengthType;
+  typedef typename TraversalSpecificationType::DataType DataType;
+  typedef typename TraversalSpecificationType::ParameterType ParameterType;
+  typedef typename TraversalSpecificationType::ValueVec ValueVec;
+  typedef vec StateType;
+
+  TraversalTaskAdjoint(
+    VectorView<NodeType> const& branch_start_nodes,
+    VectorView<NodeType> const& branch_end_nodes,
+    VectorView<LengthType> const& branch_lengths,
+    DataType const& data):
+    tree_(branch_start_nodes, branch_end_nodes, branch_lengths),
+    spec_(tree_, data),
+    algorithm_(tree_, spec_),
+    adjoint_spec_(tree_, spec_),
+    adjoint_algorithm_(tree_, adjoint_spec_),
+    id_branch_ends_(branch_end_nodes.size()) {
+    for(uint k = 0; k < branch_end_nodes.size(); k++) {
+      id_branch_ends_[k] = tree_.FindIdOfNode(branch_end_nodes[k]);
+    }
+  }
+
+  // The log-likelihood followed by its gradient with respect to the
+  // parameters.
+  StateType TraverseTree(ParameterType const& par, uint mode) {
+    StateType res = TraverseTreeAdjoint(par, mode);
+    ValueVec grad = spec_.GradientFromAdjoints(adjoint_spec_.adj_tTransf, adjoint_spec_.adj_X);
+    for(auto const& g: grad) {
+      ThreePointUsingSPLITT::AppendHighestOrder(res, g);
+    }
+    return res;
+  }
+
+  // The log-likelihood followed by its gradient with respect to the branch
+  // lengths, in the order of the branches passed to the constructor.
+  StateType BranchLengthGradient(ParameterType const& par, uint mode) {
+    StateType res = TraverseTreeAdjoint(par, mode);
+    ValueVec grad = spec_.BranchLengthGradientFromAdjoints(
+      adjoint_spec_.adj_tTransf, adjoint_spec_.adj_X);
+    for(uint id: id_branch_ends_) {
+      ThreePointUsingSPLITT::AppendHighestOrder(res, grad[id]);
+    }
+    return res;
+  }
+
+  TreeType & tree() {
+    return tree_;
+  }
+  TraversalSpecificationType & spec() {
+    return spec_;
+  }
+  AlgorithmType & algorithm() {
+    return algorithm_;
+  }
+  AdjointSpecificationType & adjoint_spec() {
+    return adjoint_spec_;
+  }
+  AdjointAlgorithmType & adjoint_algorithm() {
+    return adjoint_algorithm_;
+  }
+
+protected:
+  TreeType tree_;
+  TraversalSpecificationType spec_;
+  AlgorithmType algorithm_;
+  AdjointSpecificationType adjoint_spec_;
+  AdjointAlgorithmType adjoint_algorithm_;
+  // ids of the end nodes of the branches passed to the constructor.
+  uvec id_branch_ends_;
+
+  // Calculate the log-likelihood followed by the adjoints of tTransf and X.
+  // The mode of the pre-order traversal is chosen according to the
+  // post-order mode: auto for 0, single-threaded for modes below 20 and
+  // multi-threaded otherwise.
+  StateType TraverseTreeAdjoint(ParameterType const& par, uint mode) {
+    spec_.SetParameter(par);
+    algorithm_.TraverseTree(static_cast<ModeType>(mode));
+    StateType res = spec_.StateAtRoot();
+
+    adjoint_spec_.SetParameter(vec({-0.5, -0.5}));
+    adjoint_algorithm_.TraverseTree(
+        mode == 0? AdjointModeType::PREORDER_AUTO:
+          mode < 20? AdjointModeType::PREORDER_SINGLE_THREAD_LOOP_PREORDER:
+          AdjointModeType::PREORDER_MULTI_THREAD_LOOP_VISITS);
+    return res;
+  }
+};
+
+#endif // ParallelPruning_ThreePointUnivariateAdjoint_H_
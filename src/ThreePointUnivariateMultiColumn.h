@@ -0,0 +1,155 @@
+/*
+ *  ThreePointUnivariateMultiColumn.h
+ *  SPLITT
+ *
+ * Copyright 2017 Venelin Mitov
+ *
+ * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+ * Lineage Traversal of Trees.
+ *
+ * SPLITT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SPLITT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SPLITT.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * @author Venelin Mitov
+ */
+#ifndef ParallelPruning_ThreePointUnivariateMultiColumn_H_
+#define ParallelPruning_ThreePointUnivariateMultiColumn_H_
+
+#include "./SPLITT.h"
+
+using namespace SPLITT;
+
+// Calculate |V| and all cross-products Q_jl = X_j'V^(-1)X_l between the k
+// columns of a matrix X, for any covariance matrix V within the class of
+// “3-point structured” matrices. X must have the same number of rows as V.
+// In a single traversal, the algorithm also calculates p=1′V^(−1)1 and
+// 1′V^(−1)X_j for each column j (at the root, these are stored in p and
+// hat_mu respectively).
+//
+// This is the multi-column version of ThreePointUnivariate with X == Y. It is
+// useful for models in which the trait vector is an affine function of a few
+// parameters. Then, the quadratic form in the likelihood is a quadratic
+// polynomial in these parameters, with coefficients given by the cross-products.
+//
+// Reference: Lam Si Tung Ho and Cécile Ané. A Linear-Time Algorithm for
+// Gaussian and Non-Gaussian Trait Evolution Models. SysBiol 2014.
+template<class Tree>
+class ThreePointUnivariateMultiColumn: public TraversalSpecification<Tree> {
+
+public:
+  typedef TraversalSpecification<Tree> BaseType;
+  typedef Tree TreeType;
+  typedef vec StateType;
+  typedef vec ParameterType;
+
+  // number of columns in X
+  uint k;
+  // number of distinct cross-products, k*(k+1)/2
+  uint kk;
+
+  // public (unsafe) access to fields.
+  // X[i*k + j] is the value of column j at tip i;
+  vec X;
+  vec tTransf;
+  // hat_mu[i*k + j] is the value of hat{mu} for column j at node i;
+  vec hat_mu;
+  vec lnDetV, p;
+  // Q[i*kk + IndexQ(j, l)] is the cross-product of columns j and l at node i.
+  vec Q;
+
+  ThreePointUnivariateMultiColumn(Tree const& tree): BaseType(tree), k(0), kk(0) {
+    this->tTransf = vec(this->ref_tree_.num_nodes() - 1);
+    this->lnDetV = vec(this->ref_tree_.num_nodes(), 0);
+    this->p = vec(this->ref_tree_.num_nodes(), 0);
+  };
+
+  void set_X(vec const& X, uint num_columns) {
+    if(num_columns == 0 || X.size() != this->ref_tree_.num_tips() * num_columns) {
+      throw std::invalid_argument("ERR:01111:SPLITT:ThreePointUnivariateMultiColumn.h:set_X:: The matrix X must have at least one column and the same number of rows as V.");
+    } else {
+      this->k = num_columns;
+      this->kk = num_columns * (num_columns + 1) / 2;
+      this->X = X;
+
+      this->hat_mu = vec(this->ref_tree_.num_nodes() * k, 0);
+      this->Q = vec(this->ref_tree_.num_nodes() * kk, 0);
+    }
+  }
+
+  // position of the cross-product of columns j and l in the packed lower
+  // triangle of a node's Q block.
+  inline uint IndexQ(uint j, uint l) const {
+    return j >= l ? j*(j+1)/2 + l : l*(l+1)/2 + j;
+  }
+
+  // A vector containing lnDetV followed by the packed cross-products at the root.
+  StateType StateAtRoot() const {
+    uint i_root = this->ref_tree_.num_nodes() - 1;
+    vec res(1 + kk);
+    res[0] = this->lnDetV[i_root];
+    std::copy(Q.begin() + i_root*kk, Q.begin() + (i_root+1)*kk, res.begin() + 1);
+    return res;
+  }
+
+  inline void InitNode(uint i) {
+    if(i < this->ref_tree_.num_nodes() - 1) {
+      tTransf[i] = this->ref_tree_.LengthOfBranch(i);
+    }
+    lnDetV[i] = p[i] = 0;
+    std::fill(hat_mu.begin() + i*k, hat_mu.begin() + (i+1)*k, 0.0);
+    std::fill(Q.begin() + i*kk, Q.begin() + (i+1)*kk, 0.0);
+  }
+
+  inline void VisitNode(uint i) {
+    double* hat_mu_i = &hat_mu[i*k];
+    double* Q_i = &Q[i*kk];
+    if(i < this->ref_tree_.num_tips()) {
+      // branch leading to a tip
+      double const* X_i = &X[i*k];
+      lnDetV[i] = log(tTransf[i]);
+      p[i] = 1 / tTransf[i];
+      for(uint j = 0; j < k; j++) {
+        hat_mu_i[j] = X_i[j];
+        for(uint l = 0; l <= j; l++) {
+          Q_i[IndexQ(j, l)] = X_i[j] * X_i[l] / tTransf[i];
+        }
+      }
+    } else {
+      double f = tTransf[i]*p[i]*p[i] / (1 + tTransf[i]*p[i]);
+      for(uint j = 0; j < k; j++) {
+        hat_mu_i[j] /= p[i];
+      }
+      for(uint j = 0; j < k; j++) {
+        for(uint l = 0; l <= j; l++) {
+          Q_i[IndexQ(j, l)] -= f * hat_mu_i[j] * hat_mu_i[l];
+        }
+      }
+      lnDetV[i] += log(1 + tTransf[i]*p[i]);
+      p[i] /= (1 + tTransf[i]*p[i]);
+    }
+  }
+
+  inline void PruneNode(uint i, uint i_parent) {
+    for(uint j = 0; j < k; j++) {
+      hat_mu[i_parent*k + j] += p[i]*hat_mu[i*k + j];
+    }
+    for(uint jl = 0; jl < kk; jl++) {
+      Q[i_parent*kk + jl] += Q[i*kk + jl];
+    }
+    lnDetV[i_parent] += lnDetV[i];
+    p[i_parent] += p[i];
+  }
+};
+
+#endif // ParallelPruning_ThreePointUnivariateMultiColumn_H_
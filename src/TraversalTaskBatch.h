@@ -0,0 +1,128 @@
+/*
+ *  TraversalTaskBatch.h
+ *  SPLITT
+ *
+ * Copyright 2018 Venelin Mitov
+ *
+ * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+ * Lineage Traversal of Trees.
+ *
+ * SPLITT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SPLITT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SPLITT.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * @author Venelin Mitov
+ */
+#ifndef ParallelPruning_TraversalTaskBatch_H_
+#define ParallelPruning_TraversalTaskBatch_H_
+
+#include "./SPLITT.h"
+#include <algorithm>
+
+using namespace SPLITT;
+
+// The use of a budget of threads for a number of independent jobs, each of
+// them traversing a tree: num_outer_threads jobs are run at the same time,
+// each of them by a team of num_inner_threads threads.
+struct BatchParallelism {
+  uint num_outer_threads;
+  uint num_inner_threads;
+};
+
+// Plan the parallel execution of num_jobs independent jobs on trees with up
+// to num_tips tips, using up to num_threads threads in total (0 means the
+// maximum number of OpenMP threads).
+//
+// The parallel traversal of a tree synchronises the threads at each level of
+// the tree, which pays off only if every thread gets enough nodes per level.
+// Hence, a traversal is given at most num_tips / min_tips_per_thread threads
+// (at least 1). The jobs are parallelised first, because they need no
+// synchronisation, and the threads left are given to the traversals:
+// - many jobs or small trees: parallel across jobs, serial traversals;
+// - a single job on a big tree: a single parallel traversal;
+// - a few jobs on big trees: both, i.e. nested parallel regions.
+inline BatchParallelism PlanBatchParallelism(
+    uint num_jobs, uint num_tips, uint num_threads,
+    uint min_tips_per_thread) {
+
+  if(num_threads == 0) {
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#else
+    num_threads = 1;
+#endif // #ifdef _OPENMP
+  }
+
+  BatchParallelism res;
+  res.num_outer_threads = std::max(uint(1), std::min(num_jobs, num_threads));
+  uint max_inner_threads =
+    std::max(uint(1), num_tips / std::max(uint(1), min_tips_per_thread));
+  res.num_inner_threads = std::max(
+    uint(1), std::min(max_inner_threads, num_threads / res.num_outer_threads));
+  return res;
+}
+
+// Call f(i, mode) for i = 0, ..., num_jobs - 1, in parallel as planned in
+// plan. The jobs are distributed dynamically across the outer threads. The
+// mode passed to f is serial_mode if each job gets a single thread and
+// parallel_mode otherwise. f must be thread-safe if plan.num_outer_threads
+// is greater than 1.
+template<class Function>
+void RunBatch(BatchParallelism const& plan, uint num_jobs,
+              uint serial_mode, uint parallel_mode, Function f) {
+
+  uint mode = plan.num_inner_threads == 1? serial_mode: parallel_mode;
+  ThreadExceptionHandler exception_handler;
+
+#ifdef _OPENMP
+  int max_active_levels = omp_get_max_active_levels();
+  int num_threads = omp_get_max_threads();
+  if(plan.num_outer_threads > 1 && plan.num_inner_threads > 1) {
+    omp_set_max_active_levels(2);
+  }
+#endif // #ifdef _OPENMP
+
+  if(plan.num_outer_threads == 1) {
+#ifdef _OPENMP
+    omp_set_num_threads(plan.num_inner_threads);
+#endif // #ifdef _OPENMP
+    for(uint i = 0; i < num_jobs; i++) {
+      exception_handler.Run([&, i]{
+        f(i, mode);
+      });
+    }
+  } else {
+#pragma omp parallel num_threads(plan.num_outer_threads)
+{
+#ifdef _OPENMP
+    // the number of threads of the parallel regions nested in this thread.
+    omp_set_num_threads(plan.num_inner_threads);
+#endif // #ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+    for(uint i = 0; i < num_jobs; i++) {
+      exception_handler.Run([&, i]{
+        f(i, mode);
+      });
+    }
+}
+  }
+
+#ifdef _OPENMP
+  omp_set_max_active_levels(max_active_levels);
+  omp_set_num_threads(num_threads);
+#endif // #ifdef _OPENMP
+
+  exception_handler.Rethrow();
+}
+
+#endif // ParallelPruning_TraversalTaskBatch_H_
@@ -0,0 +1,320 @@
+/*
+ *  TraversalTaskIncremental.h
+ *  SPLITT
+ *
+ * Copyright 2018 Venelin Mitov
+ *
+ * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+ * Lineage Traversal of Trees.
+ *
+ * SPLITT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SPLITT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SPLITT.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * @author Venelin Mitov
+ */
+#ifndef ParallelPruning_TraversalTaskIncremental_H_
+#define ParallelPruning_TraversalTaskIncremental_H_
+
+#include "./SPLITT.h"
+#include <algorithm>
+#include <sstream>
+
+using namespace SPLITT;
+
+// A traversal task which keeps the per-node state of the last post-order
+// traversal and, after a local change of the tree or of the data, recomputes
+// only the nodes affected by the change and their ancestors.
+//
+// After a traversal, the state at each node (except the root) is the one
+// produced by its VisitNode; PruneNode reads this state and adds it to the
+// state of the parent. Thus, a node can be recomputed from the states of its
+// children by calling InitNode, PruneNode for each child and VisitNode. The
+// changed nodes are marked dirty together with all nodes on their path to
+// the root, and the dirty nodes are recomputed in post-order, i.e. children
+// before parents. For a change of a single branch or tip value, this takes
+// time proportional to the depth of the node instead of the size of the tree.
+//
+// Topology edits (SPR and NNI moves) keep the ids of the nodes and change
+// only the parents, the children and the branch lengths of a few nodes (see
+// OrderedTree::SubtreePruneAndRegraft). The nodes on the old and the new
+// paths to the root of the moved nodes are marked dirty. Since the ids are
+// no longer ordered after such an edit, the tree is reordered before the next
+// full traversal (OrderedTree::Reorder). Similarly, new tips can be inserted
+// on existing branches (OrderedTree::InsertTip).
+//
+// Spec must implement the methods:
+// - UpdateBranchLength(i), called after the length of the branch leading to
+// node i has been changed in the tree. The method updates any quantities of
+// the spec depending on this length and returns the ids of the nodes whose
+// InitNode depends on it;
+// - UpdateTipValue(i, value), setting the data value at tip i and returning
+// the ids of the nodes whose InitNode depends on it;
+// - PermuteNodes(id_old), permuting the per-node quantities of the spec after
+// the tree has assigned new ids to its nodes;
+// - InsertTip(i, value), growing the per-node quantities of the spec after 
+// a tip with id i and data value value has been inserted in the tree and 
+// returning the ids of the nodes whose InitNode depends on the insertion.
+//
+// A full traversal is done if the parameter differs from the one of the last
+// traversal, or if the number of dirty nodes exceeds a fraction
+// max_fraction_dirty of the nodes in the tree.
+template<class Spec>
+class TraversalTaskIncremental {
+public:
+  typedef Spec TraversalSpecificationType;
+  typedef typename Spec::TreeType TreeType;
+  typedef typename Spec::AlgorithmType AlgorithmType;
+  typedef typename AlgorithmType::ModeType ModeType;
+  typedef typename TreeType::NodeType NodeType;
+  typedef typename TreeType::LengthType LengthType;
+  typedef typename Spec::DataType DataType;
+  typedef typename Spec::ParameterType ParameterType;
+  typedef typename Spec::StateType StateType;
+
+  TraversalTaskIncremental(
+    VectorView<NodeType> const& branch_start_nodes,
+    VectorView<NodeType> const& branch_end_nodes,
+    VectorView<LengthType> const& branch_lengths,
+    DataType const& data):
+    tree_(branch_start_nodes, branch_end_nodes, branch_lengths),
+    spec_(tree_, data),
+    algorithm_(tree_, spec_),
+    has_state_(false),
+    max_fraction_dirty_(0.1),
+    num_nodes_visited_(0),
+    dirty_(tree_.num_nodes(), false) {}
+
+  StateType TraverseTree(ParameterType const& par, uint mode) {
+    if(!has_state_ || par != par_ ||
+       dirty_nodes_.size() > max_fraction_dirty_ * tree_.num_nodes()) {
+      has_state_ = false;
+      if(!tree_.is_ordered()) {
+        spec_.PermuteNodes(tree_.Reorder());
+        algorithm_.UpdateTopology();
+        std::fill(dirty_.begin(), dirty_.end(), false);
+        dirty_nodes_.clear();
+      }
+      spec_.SetParameter(par);
+      algorithm_.TraverseTree(static_cast<ModeType>(mode));
+      par_ = par;
+      has_state_ = true;
+      num_nodes_visited_ = tree_.num_nodes();
+    } else {
+      RecomputeDirtyNodes();
+      num_nodes_visited_ = dirty_nodes_.size();
+    }
+    for(uint i: dirty_nodes_) {
+      dirty_[i] = false;
+    }
+    dirty_nodes_.clear();
+    return spec_.StateAtRoot();
+  }
+
+  // Set the length of the branch leading to the node with id i.
+  void SetLengthOfBranch(uint i, LengthType const& value) {
+    tree_.SetLengthOfBranch(i, value);
+    for(uint j: spec_.UpdateBranchLength(i)) {
+      MarkDirty(j);
+    }
+  }
+
+  // Set the lengths of the branches leading to the nodes nodes_branch_ends.
+  void SetBranchLengths(std::vector<NodeType> const& nodes_branch_ends,
+                        std::vector<LengthType> const& lengths) {
+    if(nodes_branch_ends.size() != lengths.size()) {
+      throw std::invalid_argument("ERR:01131:SPLITT:TraversalTaskIncremental.h:SetBranchLengths:: The vectors nodes_branch_ends and lengths should be the same size.");
+    }
+    for(uint k = 0; k < nodes_branch_ends.size(); k++) {
+      SetLengthOfBranch(FindIdOfNonRootNode(nodes_branch_ends[k]), lengths[k]);
+    }
+  }
+
+  // Prune the subtree rooted at node together with its parent and regraft it
+  // on the branch leading to node_target at distance position from
+  // node_target.
+  void SubtreePruneAndRegraft(NodeType const& node, NodeType const& node_target,
+                              LengthType const& position) {
+    uvec changed = tree_.SubtreePruneAndRegraft(
+      FindIdOfNonRootNode(node), FindIdOfNonRootNode(node_target), position);
+    MarkDirtyPaths(changed);
+    for(uint i: changed) {
+      for(uint j: spec_.UpdateBranchLength(i)) {
+        MarkDirty(j);
+      }
+    }
+  }
+
+  // Interchange node1, a child of a node u, and node2, a sibling of u.
+  void NearestNeighborInterchange(NodeType const& node1, NodeType const& node2) {
+    uvec changed = tree_.NearestNeighborInterchange(
+      FindIdOfNonRootNode(node1), FindIdOfNonRootNode(node2));
+    MarkDirtyPaths(changed);
+    for(uint i: changed) {
+      for(uint j: spec_.UpdateBranchLength(i)) {
+        MarkDirty(j);
+      }
+    }
+  }
+
+  // Attach a new tip tip_node with data value value to a new internal node
+  // node inserted on the branch leading to node_target at distance position
+  // from node_target. The cost does not depend on the size of the tree.
+  void InsertTip(NodeType const& node_target, NodeType const& tip_node,
+                 NodeType const& node, LengthType const& position,
+                 LengthType const& length_tip, double value) {
+    uvec changed = tree_.InsertTip(
+      FindIdOfNonRootNode(node_target), tip_node, node, position, length_tip);
+    // two nodes have changed their ids.
+    tree_.MoveValuesAfterInsertTip(dirty_);
+    for(uint& i: dirty_nodes_) {
+      i = tree_.IdAfterInsertTip(i);
+    }
+    dirty_[changed[0]] = dirty_[changed[1]] = false;
+    MarkDirtyPaths(changed);
+    for(uint j: spec_.InsertTip(changed[0], value)) {
+      MarkDirty(j);
+    }
+  }
+
+  // Set the data values at the tips tip_nodes.
+  void SetTipValues(std::vector<NodeType> const& tip_nodes, vec const& values) {
+    if(tip_nodes.size() != values.size()) {
+      throw std::invalid_argument("ERR:01133:SPLITT:TraversalTaskIncremental.h:SetTipValues:: The vectors tip_nodes and values should be the same size.");
+    }
+    for(uint k = 0; k < tip_nodes.size(); k++) {
+      uint i = tree_.FindIdOfNode(tip_nodes[k]);
+      if(i == G_NA_UINT || i >= tree_.num_tips()) {
+        std::ostringstream oss;
+        oss<<"ERR:01134:SPLITT:TraversalTaskIncremental.h:SetTipValues:: The node "<<
+          tip_nodes[k]<<" is not a tip."<<std::endl;
+        throw std::logic_error(oss.str());
+      }
+      for(uint j: spec_.UpdateTipValue(i, values[k])) {
+        MarkDirty(j);
+      }
+    }
+  }
+
+  // The maximum fraction of dirty nodes, above which a full traversal is
+  // done.
+  double max_fraction_dirty() const {
+    return max_fraction_dirty_;
+  }
+  void set_max_fraction_dirty(double max_fraction_dirty) {
+    max_fraction_dirty_ = max_fraction_dirty;
+  }
+
+  // The number of nodes visited during the last call to TraverseTree.
+  uint num_nodes_visited() const {
+    return num_nodes_visited_;
+  }
+
+  TreeType & tree() {
+    return tree_;
+  }
+  TraversalSpecificationType & spec() {
+    return spec_;
+  }
+  AlgorithmType & algorithm() {
+    return algorithm_;
+  }
+
+protected:
+  TreeType tree_;
+  TraversalSpecificationType spec_;
+  AlgorithmType algorithm_;
+
+  // is the per-node state the one of a traversal with parameter par_?
+  bool has_state_;
+  ParameterType par_;
+  double max_fraction_dirty_;
+  uint num_nodes_visited_;
+
+  std::vector<bool> dirty_;
+  uvec dirty_nodes_;
+
+  // Mark node i and all its ancestors dirty. The ancestors of a dirty node
+  // are already dirty.
+  void MarkDirty(uint i) {
+    while(!dirty_[i]) {
+      dirty_[i] = true;
+      dirty_nodes_.push_back(i);
+      if(i == tree_.num_nodes() - 1) break;
+      i = tree_.FindIdOfParent(i);
+    }
+  }
+
+  uint FindIdOfNonRootNode(NodeType const& node) const {
+    uint i = tree_.FindIdOfNode(node);
+    if(i == G_NA_UINT || i == tree_.num_nodes() - 1) {
+      std::ostringstream oss;
+      oss<<"ERR:01132:SPLITT:TraversalTaskIncremental.h:FindIdOfNonRootNode:: No branch ends at node "<<
+        node<<"."<<std::endl;
+      throw std::logic_error(oss.str());
+    }
+    return i;
+  }
+
+  // Mark dirty the nodes whose parent has changed after a topology edit
+  // and their new paths to the root. This does not rely on the ancestors of
+  // a dirty node being dirty, because the old and the new paths differ.
+  void MarkDirtyPaths(uvec const& nodes) {
+    for(uint i: nodes) {
+      for(uint j = i; ; j = tree_.FindIdOfParent(j)) {
+        if(!dirty_[j]) {
+          dirty_[j] = true;
+          dirty_nodes_.push_back(j);
+        }
+        if(j == tree_.num_nodes() - 1) break;
+      }
+    }
+  }
+
+  // Recompute the dirty nodes in post-order, starting from the root. Every
+  // dirty node has a dirty parent, so only the dirty subtree is explored.
+  void RecomputeDirtyNodes() {
+    if(dirty_nodes_.empty()) return;
+    // pairs (node, are its children already recomputed?)
+    std::vector<std::pair<uint, bool> > stack;
+    stack.reserve(dirty_nodes_.size());
+    stack.push_back(std::make_pair(tree_.num_nodes() - 1, false));
+    while(!stack.empty()) {
+      std::pair<uint, bool> top = stack.back();
+      stack.pop_back();
+      if(top.second) {
+        RecomputeNode(top.first);
+      } else {
+        stack.push_back(std::make_pair(top.first, true));
+        for(uint j: tree_.FindChildren(top.first)) {
+          if(dirty_[j]) {
+            stack.push_back(std::make_pair(j, false));
+          }
+        }
+      }
+    }
+  }
+
+  void RecomputeNode(uint i) {
+    spec_.InitNode(i);
+    for(uint j: tree_.FindChildren(i)) {
+      spec_.PruneNode(j, i);
+    }
+    // the root is not visited in a post-order traversal.
+    if(i < tree_.num_nodes() - 1) {
+      spec_.VisitNode(i);
+    }
+  }
+};
+
+#endif // ParallelPruning_TraversalTaskIncremental_H_
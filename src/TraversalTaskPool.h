@@ -0,0 +1,202 @@
+/*
+ *  TraversalTaskPool.h
+ *  SPLITT
+ *
+ * Copyright 2018 Venelin Mitov
+ *
+ * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+ * Lineage Traversal of Trees.
+ *
+ * SPLITT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SPLITT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SPLITT.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * @author Venelin Mitov
+ */
+#ifndef ParallelPruning_TraversalTaskPool_H_
+#define ParallelPruning_TraversalTaskPool_H_
+
+#include "./SPLITT.h"
+#include "./TraversalTaskBatch.h"
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+using namespace SPLITT;
+
+// A traversal task which can be used by several threads at the same time.
+//
+// The spec of a TraversalTask holds the per-node state of the traversal
+// (e.g. the 3-point quantities of the POUMM), so that a task can do only one
+// traversal at a time. The pool separates the immutable tree, which is built
+// once and only read during the traversals, from a fixed number of
+// workspaces. Each workspace is a TraversalTaskLightweight on the shared
+// tree, i.e. a spec with its mutable per-node state and an algorithm. A call
+// to TraverseTree takes a free workspace from the pool, waiting if all of
+// them are in use, and returns it to the pool after the traversal. Thus, up
+// to num_workspaces threads can evaluate different parameters concurrently.
+//
+// The first workspace is constructed from the data. The specs of the other
+// workspaces are constructed from the spec of the first one and share with
+// it the quantities depending only on the tree and the data (e.g. the trait
+// values and the node heights in ThreePointPOUMM), which the pool does not
+// modify. Thus, Spec must have a constructor Spec(tree, other_spec) (see
+// TraversalTaskLightweight). Each workspace still holds the mutable per-node
+// state of a traversal and any parameter-dependent cache (e.g. the
+// exponentials of alpha in ThreePointPOUMM), about 170 bytes per tip for
+// ThreePointPOUMM, so the memory grows with the number of workspaces.
+//
+// By default, the pool has only as many workspaces as are needed to keep all
+// OpenMP threads busy in TraverseTreeMany: one per thread for small trees,
+// where each parameter is evaluated by a single thread, and fewer for big
+// trees, where a team of up to num_tips/min_tips_per_thread threads
+// traverses the tree for each parameter (see PlanBatchParallelism).
+template<class Spec>
+class TraversalTaskPool {
+public:
+  typedef Spec TraversalSpecificationType;
+  typedef typename Spec::TreeType TreeType;
+  typedef typename Spec::AlgorithmType AlgorithmType;
+  typedef typename TreeType::NodeType NodeType;
+  typedef typename TreeType::LengthType LengthType;
+  typedef typename Spec::DataType DataType;
+  typedef typename Spec::ParameterType ParameterType;
+  typedef typename Spec::StateType StateType;
+  typedef TraversalTaskLightweight<Spec> WorkspaceType;
+
+  // num_workspaces = 0 means the default number of workspaces (see above).
+  TraversalTaskPool(
+    VectorView<NodeType> const& branch_start_nodes,
+    VectorView<NodeType> const& branch_end_nodes,
+    VectorView<LengthType> const& branch_lengths,
+    DataType const& data,
+    uint num_workspaces = 0):
+    tree_(branch_start_nodes, branch_end_nodes, branch_lengths),
+    min_tips_per_thread_(1000) {
+
+    plan_.num_outer_threads = plan_.num_inner_threads = 1;
+
+    if(num_workspaces == 0) {
+#ifdef _OPENMP
+      uint num_threads = omp_get_max_threads();
+#else
+      uint num_threads = 1;
+#endif // #ifdef _OPENMP
+      // the threads divided in teams of the largest size allowed for the tree.
+      uint num_inner_threads = PlanBatchParallelism(
+        1, tree_.num_tips(), num_threads, min_tips_per_thread_).num_inner_threads;
+      num_workspaces = (num_threads + num_inner_threads - 1) / num_inner_threads;
+    }
+    workspaces_.reserve(num_workspaces);
+    free_workspaces_.reserve(num_workspaces);
+    workspaces_.push_back(
+      std::unique_ptr<WorkspaceType>(new WorkspaceType(tree_, data)));
+    for(uint i = 1; i < num_workspaces; i++) {
+      workspaces_.push_back(
+        std::unique_ptr<WorkspaceType>(
+          new WorkspaceType(tree_, workspaces_[0]->spec())));
+    }
+    for(uint i = 0; i < num_workspaces; i++) {
+      free_workspaces_.push_back(i);
+    }
+  }
+
+  // Thread-safe.
+  StateType TraverseTree(ParameterType const& par, uint mode) {
+    WorkspaceLock lock(*this);
+    return workspaces_[lock.id()]->TraverseTree(par, mode);
+  }
+
+  // Traverse the tree for each of the parameters in pars. The OpenMP threads
+  // are split between the parameters, evaluated concurrently on up to
+  // num_workspaces workspaces, and the traversals (see PlanBatchParallelism).
+  // A traversal done by a single thread uses serial_mode, while a traversal
+  // done by a team of threads uses mode.
+  std::vector<StateType> TraverseTreeMany(
+      std::vector<ParameterType> const& pars, uint mode,
+      uint serial_mode = 10) {
+
+    plan_ = PlanBatchParallelism(
+      std::min(uint(pars.size()), num_workspaces()), tree_.num_tips(), 0,
+      min_tips_per_thread_);
+
+    std::vector<StateType> res(pars.size());
+    RunBatch(plan_, pars.size(), serial_mode, mode, [&](uint i, uint mode_i) {
+      res[i] = TraverseTree(pars[i], mode_i);
+    });
+    return res;
+  }
+
+  uint num_workspaces() const {
+    return workspaces_.size();
+  }
+  // the minimum number of tips per thread of a parallel traversal.
+  uint min_tips_per_thread() const {
+    return min_tips_per_thread_;
+  }
+  void set_min_tips_per_thread(uint min_tips_per_thread) {
+    min_tips_per_thread_ = min_tips_per_thread;
+  }
+  // the plan of the last call to TraverseTreeMany.
+  BatchParallelism const& plan() const {
+    return plan_;
+  }
+  TreeType const& tree() const {
+    return tree_;
+  }
+  // Not thread-safe: the workspace may be in use by another thread.
+  WorkspaceType & workspace(uint i) {
+    return *workspaces_[i];
+  }
+
+protected:
+  TreeType tree_;
+  std::vector<std::unique_ptr<WorkspaceType> > workspaces_;
+
+  uint min_tips_per_thread_;
+  BatchParallelism plan_;
+
+  // ids of the workspaces not in use, guarded by mutex_.
+  uvec free_workspaces_;
+  std::mutex mutex_;
+  std::condition_variable workspace_released_;
+
+  // Takes a free workspace from the pool for the lifetime of the object,
+  // returning it also if the traversal throws.
+  class WorkspaceLock {
+  public:
+    WorkspaceLock(TraversalTaskPool& pool): pool_(pool) {
+      std::unique_lock<std::mutex> lock(pool_.mutex_);
+      pool_.workspace_released_.wait(lock, [this]{
+        return !pool_.free_workspaces_.empty();
+      });
+      id_ = pool_.free_workspaces_.back();
+      pool_.free_workspaces_.pop_back();
+    }
+    ~WorkspaceLock() {
+      {
+        std::lock_guard<std::mutex> lock(pool_.mutex_);
+        pool_.free_workspaces_.push_back(id_);
+      }
+      pool_.workspace_released_.notify_one();
+    }
+    uint id() const {
+      return id_;
+    }
+  private:
+    TraversalTaskPool& pool_;
+    uint id_;
+  };
+};
+
+#endif // ParallelPruning_TraversalTaskPool_H_
@@ -0,0 +1,113 @@
+/*
+ *  TraversalTaskSharedTree.h
+ *  SPLITT
+ *
+ * Copyright 2018 Venelin Mitov
+ *
+ * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+ * Lineage Traversal of Trees.
+ *
+ * SPLITT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SPLITT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SPLITT.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * @author Venelin Mitov
+ */
+#ifndef ParallelPruning_TraversalTaskSharedTree_H_
+#define ParallelPruning_TraversalTaskSharedTree_H_
+
+#include "./SPLITT.h"
+#include <memory>
+
+using namespace SPLITT;
+
+// A handle to a tree which is built once and shared by several traversal
+// tasks, e.g. for different models fitted on the same tree. Copies of the
+// handle refer to the same tree, which is destroyed with the last handle or
+// task referring to it.
+template<class Tree>
+class SharedTree {
+public:
+  typedef Tree TreeType;
+  typedef typename TreeType::NodeType NodeType;
+  typedef typename TreeType::LengthType LengthType;
+
+  SharedTree(
+    VectorView<NodeType> const& branch_start_nodes,
+    VectorView<NodeType> const& branch_end_nodes,
+    VectorView<LengthType> const& branch_lengths):
+    tree_(std::make_shared<TreeType>(
+        branch_start_nodes, branch_end_nodes, branch_lengths)) {}
+
+  uint num_tips() const {
+    return tree_->num_tips();
+  }
+  uint num_nodes() const {
+    return tree_->num_nodes();
+  }
+  // the number of handles and tasks sharing the tree.
+  uint use_count() const {
+    return tree_.use_count();
+  }
+
+  std::shared_ptr<TreeType const> const& ptr() const {
+    return tree_;
+  }
+  TreeType const& tree() const {
+    return *tree_;
+  }
+
+protected:
+  std::shared_ptr<TreeType const> tree_;
+};
+
+// A TraversalTaskLightweight on a SharedTree. The task keeps the tree alive,
+// so that it remains valid after the handle used to create the task has been
+// destroyed.
+template<class TraversalSpecification>
+class TraversalTaskSharedTree {
+public:
+  typedef TraversalTaskLightweight<TraversalSpecification> TaskType;
+  typedef typename TaskType::TreeType TreeType;
+  typedef typename TaskType::AlgorithmType AlgorithmType;
+  typedef typename TaskType::DataType DataType;
+  typedef typename TaskType::ParameterType ParameterType;
+  typedef typename TaskType::StateType StateType;
+
+  TraversalTaskSharedTree(
+    SharedTree<TreeType> const& tree,
+    DataType const& data):
+    tree_(tree.ptr()),
+    task_(*tree_, data) {}
+
+  StateType TraverseTree(ParameterType const& par, uint mode) {
+    return task_.TraverseTree(par, mode);
+  }
+
+  TreeType const& tree() const {
+    return *tree_;
+  }
+  TraversalSpecification & spec() {
+    return task_.spec();
+  }
+  AlgorithmType & algorithm() {
+    return task_.algorithm();
+  }
+
+protected:
+  // declared before task_, so that the tree is alive while task_ exists.
+  std::shared_ptr<TreeType const> tree_;
+  TaskType task_;
+};
+
+#endif // ParallelPruning_TraversalTaskSharedTree_H_
@@ -0,0 +1,469 @@
+/*
+ *  TraversalTaskTreeSet.h
+ *  SPLITT
+ *
+ * Copyright 2018 Venelin Mitov
+ *
+ * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+ * Lineage Traversal of Trees.
+ *
+ * SPLITT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SPLITT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SPLITT.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * @author Venelin Mitov
+ */
+#ifndef ParallelPruning_TraversalTaskTreeSet_H_
+#define ParallelPruning_TraversalTaskTreeSet_H_
+
+#include "./SPLITT.h"
+#include "./TraversalTaskBatch.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+using namespace SPLITT;
+
+// A set of trees with the same model, e.g. a posterior sample of trees on
+// the same tips, evaluated for one parameter at a time. The trees are added
+// one by one, so that they can be read from a file (or received from another
+// application) without keeping them all in memory before they are built.
+//
+// The set keeps only the OrderedTree of each tree. The trait values, which
+// must be the same for all trees, are stored once, together with their
+// positions in the order of the tip ids of each tree (the trait ordering of
+// the tree, see NumericTraitData::PositionsInTipOrder). The per-node state of
+// the traversals is held by workspaces: for each class of trees with the same
+// numbers of tips and nodes (a size class), one TraversalTaskLightweight per
+// tree traversed in parallel, created when first needed and taken by the
+// threads as in TraversalTaskPool. A workspace has its own copy of a tree of
+// its size class. To evaluate a tree, the OrderedTree of the tree is swapped
+// (in constant time) with the one of the workspace, the algorithm of the
+// workspace updates the topology and the spec recalculates the quantities
+// depending on the tree and the data by Spec::ReplaceTree(x_tips), where
+// x_tips are the trait values in tip order. The tree is swapped back after
+// the traversal. Thus, the memory grows with the number of trees only by the
+// trees themselves and their trait orderings, at the cost of recalculating
+// the data-derived quantities, e.g. the node heights in ThreePointPOUMM, at
+// each traversal of a tree.
+//
+// TraverseTrees evaluates the parameter on all trees, splitting the threads
+// between the trees and the traversal of each tree (see
+// PlanBatchParallelism). The mode AUTO tunes the traversal on the first
+// workspace of each size class, with the first tree of the class. The other
+// trees of the class use the mode chosen for it, instead of tuning their own
+// (Spec::AlgorithmType must be a PostOrderTraversal).
+//
+// Trees of a posterior sample share most of their clades, often with the
+// same branch lengths. With the clade cache enabled (set_use_clade_cache),
+// the state of each visited node (Spec::StateOfNode), which summarises the
+// subtree rooted at the node and the branch leading to it, is stored under a
+// hash of the clade. The hash is calculated from the hashes of the children,
+// the length of the branch and the values returned by
+// Spec::HashInputsOfNode, e.g. the trait value of a tip. A tree is traversed
+// from its root towards the tips to find the deepest nodes whose clade is in
+// the cache. Their states are restored by Spec::SetStateOfNode, their
+// subtrees are skipped, and only the other nodes are visited. The cache
+// holds the states for one parameter and is cleared when the parameter
+// changes. With the clade cache, the trees are traversed one after the
+// other, in a single thread, so that each tree reuses the clades of the
+// trees before it. Two different clades are taken for the same only if
+// their 64-bit hashes collide, which is negligibly rare.
+template<class Spec>
+class TraversalTaskTreeSet {
+public:
+  typedef TraversalTaskLightweight<Spec> WorkspaceTaskType;
+  typedef typename Spec::TreeType TreeType;
+  typedef typename TreeType::NodeType NodeType;
+  typedef typename TreeType::LengthType LengthType;
+  typedef typename Spec::DataType DataType;
+  typedef typename Spec::ParameterType ParameterType;
+  typedef typename Spec::StateType StateType;
+
+  typedef typename Spec::NodeState NodeStateType;
+
+  TraversalTaskTreeSet():
+    min_tips_per_thread_(1000), use_clade_cache_(false),
+    num_nodes_visited_(0) {
+    plan_.num_outer_threads = plan_.num_inner_threads = 1;
+  }
+
+  // Returns the index of the tree in the set. The values of data must be the
+  // same for all trees; only the tips to which they belong can differ.
+  uint AddTree(
+    VectorView<NodeType> const& branch_start_nodes,
+    VectorView<NodeType> const& branch_end_nodes,
+    VectorView<LengthType> const& branch_lengths,
+    DataType const& data) {
+
+    std::unique_ptr<TreeType> tree(new TreeType(
+        branch_start_nodes, branch_end_nodes, branch_lengths));
+    uvec positions = data.PositionsInTipOrder(*tree);
+    if(trees_.empty()) {
+      values_.assign(data.x_.begin(), data.x_.end());
+    } else if(values_.size() != data.x_.size() ||
+              !std::equal(values_.begin(), values_.end(), data.x_.begin())) {
+      throw std::invalid_argument("ERR:01701:SPLITT:TraversalTaskTreeSet.h:AddTree:: The trait values must be the same for all trees in the set.");
+    }
+
+    uint i = trees_.size();
+    std::pair<uint, uint> size(tree->num_tips(), tree->num_nodes());
+    auto it = map_size_to_class_.find(size);
+    if(it == map_size_to_class_.end()) {
+      map_size_to_class_[size] = classes_.size();
+      size_class_.push_back(classes_.size());
+      classes_.push_back(SizeClass());
+      classes_.back().first_tree = i;
+      classes_.back().num_trees = 1;
+    } else {
+      size_class_.push_back(it->second);
+      classes_[it->second].num_trees++;
+    }
+    trees_.push_back(std::move(tree));
+    positions_.push_back(std::move(positions));
+    return i;
+  }
+
+  std::vector<StateType> TraverseTrees(ParameterType const& par, uint mode) {
+    if(use_clade_cache_) {
+      return TraverseTreesWithCladeCache(par);
+    }
+    uint num_tips = 0;
+    for(auto const& tree: trees_) {
+      num_tips = std::max(num_tips, uint(tree->num_tips()));
+    }
+    plan_ = PlanBatchParallelism(
+      trees_.size(), num_tips, 0, min_tips_per_thread_);
+    for(uint c = 0; c < classes_.size(); c++) {
+      CreateWorkspaces(c, plan_.num_outer_threads);
+    }
+
+    std::vector<StateType> res(trees_.size());
+    bool tune = mode == 0 && plan_.num_inner_threads > 1;
+    // the mode of the traversals of each size class.
+    uvec mode_of_class(classes_.size(), mode);
+    if(tune) {
+      // a step of the tuning is done on the first tree of each size class
+      // with all threads, before the other trees use its mode.
+      for(uint c = 0; c < classes_.size(); c++) {
+        Workspace& workspace = *classes_[c].workspaces[0];
+        res[classes_[c].first_tree] = TraverseTreeOnWorkspace(
+          classes_[c].first_tree, workspace, par, mode);
+        mode_of_class[c] =
+          static_cast<uint>(workspace.task.algorithm().ModeAuto());
+      }
+    }
+
+    RunBatch(plan_, trees_.size(), 10, mode, [&](uint i, uint mode_i) {
+      uint c = size_class_[i];
+      if(tune) {
+        if(classes_[c].first_tree == i) return;
+        mode_i = mode_of_class[c];
+      }
+      WorkspaceLock lock(*this, c);
+      res[i] = TraverseTreeOnWorkspace(
+        i, *classes_[c].workspaces[lock.id()], par, mode_i);
+    });
+    num_nodes_visited_ = 0;
+    for(auto const& tree: trees_) {
+      num_nodes_visited_ += tree->num_nodes();
+    }
+    return res;
+  }
+
+  uint num_trees() const {
+    return trees_.size();
+  }
+  TreeType const& tree(uint i) const {
+    return *trees_[i];
+  }
+  // the number of size classes, i.e. of distinct numbers of tips and nodes.
+  uint num_size_classes() const {
+    return classes_.size();
+  }
+  // the number of workspaces over all size classes.
+  uint num_workspaces() const {
+    uint res = 0;
+    for(auto const& size_class: classes_) {
+      res += size_class.workspaces.size();
+    }
+    return res;
+  }
+  // the minimum number of tips per thread of a parallel traversal.
+  uint min_tips_per_thread() const {
+    return min_tips_per_thread_;
+  }
+  void set_min_tips_per_thread(uint min_tips_per_thread) {
+    min_tips_per_thread_ = min_tips_per_thread;
+  }
+  // the plan of the last call to TraverseTrees.
+  BatchParallelism const& plan() const {
+    return plan_;
+  }
+  bool use_clade_cache() const {
+    return use_clade_cache_;
+  }
+  void set_use_clade_cache(bool use_clade_cache) {
+    use_clade_cache_ = use_clade_cache;
+    if(!use_clade_cache) {
+      clade_cache_.clear();
+      clade_hash_.clear();
+    }
+  }
+  // the number of clades in the cache.
+  uint num_cached_clades() const {
+    return clade_cache_.size();
+  }
+  // the number of nodes visited in the last call to TraverseTrees,
+  // excluding the nodes skipped by the clade cache.
+  uint num_nodes_visited() const {
+    return num_nodes_visited_;
+  }
+
+protected:
+  // A tree of a size class with a task on it.
+  struct Workspace {
+    TreeType tree;
+    WorkspaceTaskType task;
+    // the trait values in the order of the tip ids of the tree in use.
+    vec x_tips;
+    Workspace(TreeType const& other_tree, DataType const& data):
+      tree(other_tree), task(tree, data), x_tips(tree.num_tips()) {}
+  };
+
+  struct SizeClass {
+    // the index of the first tree of the class and the number of trees.
+    uint first_tree;
+    uint num_trees;
+    std::vector<std::unique_ptr<Workspace> > workspaces;
+    // ids of the workspaces not in use, guarded by mutex_.
+    uvec free_workspaces;
+  };
+
+  // Takes a free workspace of the size class c for the lifetime of the
+  // object, returning it also if the traversal throws.
+  class WorkspaceLock {
+  public:
+    WorkspaceLock(TraversalTaskTreeSet& set, uint c): set_(set), c_(c) {
+      std::unique_lock<std::mutex> lock(set_.mutex_);
+      set_.workspace_released_.wait(lock, [this]{
+        return !set_.classes_[c_].free_workspaces.empty();
+      });
+      id_ = set_.classes_[c_].free_workspaces.back();
+      set_.classes_[c_].free_workspaces.pop_back();
+    }
+    ~WorkspaceLock() {
+      {
+        std::lock_guard<std::mutex> lock(set_.mutex_);
+        set_.classes_[c_].free_workspaces.push_back(id_);
+      }
+      set_.workspace_released_.notify_all();
+    }
+    uint id() const {
+      return id_;
+    }
+  private:
+    TraversalTaskTreeSet& set_;
+    uint c_;
+    uint id_;
+  };
+
+  // Swaps the tree i into the tree of a workspace for the lifetime of the
+  // object, swapping it back also if the traversal throws.
+  class TreeInWorkspace {
+  public:
+    TreeInWorkspace(TreeType& tree, Workspace& workspace):
+      tree_(tree), workspace_(workspace) {
+      std::swap(tree_, workspace_.tree);
+    }
+    ~TreeInWorkspace() {
+      std::swap(tree_, workspace_.tree);
+    }
+  private:
+    TreeType& tree_;
+    Workspace& workspace_;
+  };
+
+  std::vector<std::unique_ptr<TreeType> > trees_;
+  // the trait values, shared by all trees, and the positions of the values
+  // of the tips of each tree in tip order.
+  vec values_;
+  std::vector<uvec> positions_;
+  // the size class of each tree.
+  uvec size_class_;
+  std::vector<SizeClass> classes_;
+  std::map<std::pair<uint, uint>, uint> map_size_to_class_;
+  std::mutex mutex_;
+  std::condition_variable workspace_released_;
+
+  uint min_tips_per_thread_;
+  BatchParallelism plan_;
+
+  bool use_clade_cache_;
+  uint num_nodes_visited_;
+  // the hash of the clade of each node, except the root, for each tree.
+  std::vector<std::vector<uint64_t> > clade_hash_;
+  std::unordered_map<uint64_t, NodeStateType> clade_cache_;
+  // the parameter of the states in clade_cache_.
+  ParameterType clade_cache_par_;
+
+  // Make sure the size class c has at least num_workspaces workspaces, or
+  // one per tree if it has fewer trees.
+  void CreateWorkspaces(uint c, uint num_workspaces) {
+    SizeClass& size_class = classes_[c];
+    num_workspaces = std::min(num_workspaces, size_class.num_trees);
+    TreeType const& tree = *trees_[size_class.first_tree];
+    while(size_class.workspaces.size() < num_workspaces) {
+      std::vector<NodeType> names(tree.num_tips());
+      vec x_tips(tree.num_tips());
+      for(uint i = 0; i < tree.num_tips(); i++) {
+        names[i] = tree.FindNodeWithId(i);
+        x_tips[i] = values_[positions_[size_class.first_tree][i]];
+      }
+      size_class.free_workspaces.push_back(size_class.workspaces.size());
+      size_class.workspaces.push_back(std::unique_ptr<Workspace>(
+          new Workspace(tree, DataType(names, x_tips))));
+    }
+  }
+
+  // Update the workspace after the tree i has been swapped into it.
+  void PrepareWorkspace(uint i, Workspace& workspace) {
+    workspace.task.algorithm().UpdateTopology();
+    uvec const& positions = positions_[i];
+    for(uint j = 0; j < positions.size(); j++) {
+      workspace.x_tips[j] = values_[positions[j]];
+    }
+    workspace.task.spec().ReplaceTree(workspace.x_tips);
+  }
+
+  StateType TraverseTreeOnWorkspace(
+      uint i, Workspace& workspace, ParameterType const& par, uint mode) {
+    TreeInWorkspace tree_in_workspace(*trees_[i], workspace);
+    PrepareWorkspace(i, workspace);
+    return workspace.task.TraverseTree(par, mode);
+  }
+
+  static uint64_t MixHash(uint64_t h) {
+    // the finalizer of splitmix64
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+  }
+
+  static uint64_t CombineHash(uint64_t seed, uint64_t value) {
+    return MixHash(seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+  }
+
+  static uint64_t CombineHash(uint64_t seed, double value) {
+    uint64_t bits;
+    // +0 and -0 are the same value
+    if(value == 0) value = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return CombineHash(seed, bits);
+  }
+
+  // Calculate the clade hashes of the tree k, swapped into the workspace
+  // with the tree tree and the spec spec.
+  void CalculateCladeHashes(uint k, TreeType const& tree, Spec const& spec) {
+    std::vector<uint64_t> hash(tree.num_nodes() - 1);
+    std::vector<uint64_t> hash_children;
+    // the children of a node have smaller ids than the node.
+    for(uint i = 0; i < tree.num_nodes() - 1; i++) {
+      uint64_t h = 0;
+      if(i >= tree.num_tips()) {
+        // the clade does not depend on the order of the children.
+        hash_children.clear();
+        for(uint j: tree.FindChildren(i)) {
+          hash_children.push_back(hash[j]);
+        }
+        std::sort(hash_children.begin(), hash_children.end());
+        h = CombineHash(h, uint64_t(hash_children.size()));
+        for(uint64_t hj: hash_children) {
+          h = CombineHash(h, hj);
+        }
+      }
+      for(double value: spec.HashInputsOfNode(i)) {
+        h = CombineHash(h, value);
+      }
+      hash[i] = CombineHash(h, double(tree.LengthOfBranch(i)));
+    }
+    clade_hash_[k] = std::move(hash);
+  }
+
+  std::vector<StateType> TraverseTreesWithCladeCache(ParameterType const& par) {
+    if(par != clade_cache_par_) {
+      clade_cache_.clear();
+      clade_cache_par_ = par;
+    }
+    for(uint c = 0; c < classes_.size(); c++) {
+      CreateWorkspaces(c, 1);
+    }
+    plan_.num_outer_threads = plan_.num_inner_threads = 1;
+    num_nodes_visited_ = 0;
+
+    std::vector<StateType> res(trees_.size());
+    // the status of each node: 0 for a visited node, 1 for a node with a
+    // state from the cache and 2 for a node in the subtree of such a node.
+    std::vector<unsigned char> status;
+    for(uint k = 0; k < trees_.size(); k++) {
+      Workspace& workspace = *classes_[size_class_[k]].workspaces[0];
+      TreeInWorkspace tree_in_workspace(*trees_[k], workspace);
+      PrepareWorkspace(k, workspace);
+      TreeType const& tree = workspace.tree;
+      Spec& spec = workspace.task.spec();
+      if(clade_hash_.size() <= k) {
+        clade_hash_.resize(k + 1);
+        CalculateCladeHashes(k, tree, spec);
+      }
+      std::vector<uint64_t> const& hash = clade_hash_[k];
+      uint num_nodes = tree.num_nodes();
+
+      spec.SetParameter(par);
+      status.assign(num_nodes, 0);
+      spec.InitNode(num_nodes - 1);
+      // the parents are processed before their children.
+      for(uint i = num_nodes - 1; i-- > 0; ) {
+        if(status[tree.FindIdOfParent(i)] != 0) {
+          status[i] = 2;
+        } else {
+          auto it = clade_cache_.find(hash[i]);
+          if(it != clade_cache_.end()) {
+            status[i] = 1;
+            spec.SetStateOfNode(i, it->second);
+          } else {
+            spec.InitNode(i);
+          }
+        }
+      }
+      for(uint i = 0; i < num_nodes - 1; i++) {
+        if(status[i] == 2) continue;
+        if(status[i] == 0) {
+          spec.VisitNode(i);
+          clade_cache_.emplace(hash[i], spec.StateOfNode(i));
+          num_nodes_visited_++;
+        }
+        spec.PruneNode(i, tree.FindIdOfParent(i));
+      }
+      num_nodes_visited_++;
+      res[k] = spec.StateAtRoot();
+    }
+    return res;
+  }
+};
+
+#endif // ParallelPruning_TraversalTaskTreeSet_H_
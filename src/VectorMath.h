@@ -0,0 +1,232 @@
+/*
+ *  VectorMath.h
+ *  SPLITT
+ *
+ * Copyright 2018 Venelin Mitov
+ *
+ * This file is part of SPLITT: a generic C++ library for Serial and Parallel
+ * Lineage Traversal of Trees.
+ *
+ * SPLITT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SPLITT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SPLITT.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * @author Venelin Mitov
+ */
+#ifndef ThreePointUsingSPLITT_VectorMath_H_
+#define ThreePointUsingSPLITT_VectorMath_H_
+
+#include "./SPLITT.h"
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+
+using namespace SPLITT;
+
+// Vectorised exp and log over contiguous ranges of doubles.
+//
+// The kernels are written as branch-free loops using only double and unsigned
+// 64-bit integer arithmetic, so that the compiler can vectorise them under
+// '#pragma omp simd' for the instruction set enabled at compile time, e.g.
+// SSE2 by default on x86_64, AVX2 or AVX-512 with -march=native (see the
+// comments in Makevars). Arguments outside the range of the kernels (too
+// large or too small for exp, non-positive, subnormal or non-finite for log)
+// are handled by a scalar loop calling the libm functions. The vectorised
+// loop does not branch on the arguments; the values it produces for such
+// arguments are overwritten by the scalar loop, using the arguments saved
+// before the vectorised loop.
+//
+// Accuracy: for any argument, the relative difference from the libm result
+// is below 4 units in the last place (4 * 2^-52 < 1e-15); the maximum
+// observed on random arguments over the whole range is below 2. This is
+// checked against the R-functions exp and log in
+// tests/testthat/test-VectorMath.R.
+//
+// The kernels can be switched off at run time (see UseScalarLibm), e.g. to
+// measure their speed-up in the likelihood calculation (see the R-function
+// BenchmarkVectorMath).
+namespace ThreePointUsingSPLITT {
+
+namespace VectorMath {
+
+inline double AsDouble(uint64_t i) {
+  double d;
+  std::memcpy(&d, &i, sizeof(double));
+  return d;
+}
+
+inline uint64_t AsUInt64(double d) {
+  uint64_t i;
+  std::memcpy(&i, &d, sizeof(double));
+  return i;
+}
+
+// range of arguments for which the exp kernel produces normal doubles.
+const double EXP_MIN = -708.0;
+const double EXP_MAX = 709.0;
+const double INV_LN2 = 1.4426950408889634074;
+const double LN2_HI = 6.93147180369123816490e-01;
+const double LN2_LO = 1.90821492927058770002e-10;
+// 1.5 * 2^52: adding this to a double of magnitude below 2^51 rounds it to
+// an integer stored in the low bits of the mantissa.
+const double SHIFT = 6755399441055744.0;
+
+inline double ExpKernel(double x) {
+  // x = n*ln(2) + r, |r| <= ln(2)/2, exp(x) = 2^n*exp(r)
+  double kd = x * INV_LN2 + SHIFT;
+  uint64_t ki = AsUInt64(kd);
+  kd -= SHIFT;
+  double r = x - kd * LN2_HI - kd * LN2_LO;
+  // Taylor polynomial of degree 13 for exp(r) in Horner's form.
+  double p = 1.0 / 6227020800.0;
+  p = p * r + 1.0 / 479001600.0;
+  p = p * r + 1.0 / 39916800.0;
+  p = p * r + 1.0 / 3628800.0;
+  p = p * r + 1.0 / 362880.0;
+  p = p * r + 1.0 / 40320.0;
+  p = p * r + 1.0 / 5040.0;
+  p = p * r + 1.0 / 720.0;
+  p = p * r + 1.0 / 120.0;
+  p = p * r + 1.0 / 24.0;
+  p = p * r + 1.0 / 6.0;
+  p = p * r + 0.5;
+  p = p * r + 1.0;
+  p = p * r + 1.0;
+  // 2^n: the low 12 bits of ki + 1023 are the biased exponent n + 1023.
+  double scale = AsDouble((ki + 1023) << 52);
+  return p * scale;
+}
+
+// the number of arguments processed at a time by ExpVec and LogVec.
+const uint BLOCK_SIZE = 256;
+
+// If true, ExpVec and LogVec call the libm functions exp and log for each 
+// element instead of the kernels. Default: false.
+inline bool& UseScalarLibm() {
+  static bool use_scalar_libm = false;
+  return use_scalar_libm;
+}
+
+// bit pattern of sqrt(1/2)
+const uint64_t SQRT_HALF_BITS = 0x3fe6a09e667f3bcdULL;
+const uint64_t EXPONENT_MASK = 0xfff0000000000000ULL;
+const uint64_t MIN_NORMAL_BITS = 0x0010000000000000ULL;
+const uint64_t INF_BITS = 0x7ff0000000000000ULL;
+const double TWO_POW_52 = 4503599627370496.0;
+
+inline double LogKernel(double x) {
+  // x = 2^e*m, sqrt(1/2) <= m < sqrt(2)
+  uint64_t ix = AsUInt64(x);
+  uint64_t tmp = ix - SQRT_HALF_BITS;
+  double m = AsDouble(ix - (tmp & EXPONENT_MASK));
+  // e + 1023 as a double, avoiding a 64-bit integer to double conversion,
+  // which is not available in SSE2 and AVX2.
+  double e = AsDouble(((tmp + (1023ULL << 52)) >> 52) | 0x4330000000000000ULL) -
+    TWO_POW_52 - 1023.0;
+  // log(m) = 2*atanh(f), f = (m-1)/(m+1), |f| <= 0.1716
+  double f = (m - 1.0) / (m + 1.0);
+  double f2 = f * f;
+  double p = 1.0 / 21;
+  p = p * f2 + 1.0 / 19;
+  p = p * f2 + 1.0 / 17;
+  p = p * f2 + 1.0 / 15;
+  p = p * f2 + 1.0 / 13;
+  p = p * f2 + 1.0 / 11;
+  p = p * f2 + 1.0 / 9;
+  p = p * f2 + 1.0 / 7;
+  p = p * f2 + 1.0 / 5;
+  p = p * f2 + 1.0 / 3;
+  // log(x) = e*ln(2) + 2*f + 2*f^3*p
+  return e * LN2_HI + ((2.0 * f) * (f2 * p) + e * LN2_LO + 2.0 * f);
+}
+}
+
+// y[i] = exp(x[i]) for i in 0, ..., n-1. x and y can point to the same array:
+// the arguments handled by the scalar fallback are saved, one block at a
+// time, before the vectorised loop overwrites them.
+inline void ExpVec(double const* x, double* y, uint n) {
+  if(VectorMath::UseScalarLibm()) {
+    for(uint i = 0; i < n; i++) {
+      y[i] = exp(x[i]);
+    }
+    return;
+  }
+  uint index[VectorMath::BLOCK_SIZE];
+  double value[VectorMath::BLOCK_SIZE];
+  for(uint start = 0; start < n; start += VectorMath::BLOCK_SIZE) {
+    uint end = std::min(n, start + VectorMath::BLOCK_SIZE);
+    // under-/overflow, infinities and NaNs.
+    uint m = 0;
+    for(uint i = start; i < end; i++) {
+      if(!(x[i] >= VectorMath::EXP_MIN && x[i] <= VectorMath::EXP_MAX)) {
+        index[m] = i;
+        value[m] = x[i];
+        m++;
+      }
+    }
+    _PRAGMA_OMP_SIMD
+    for(uint i = start; i < end; i++) {
+      y[i] = VectorMath::ExpKernel(x[i]);
+    }
+    for(uint k = 0; k < m; k++) {
+      y[index[k]] = exp(value[k]);
+    }
+  }
+}
+
+// y[i] = log(x[i]) for i in 0, ..., n-1. x and y can point to the same array
+// (see ExpVec).
+inline void LogVec(double const* x, double* y, uint n) {
+  if(VectorMath::UseScalarLibm()) {
+    for(uint i = 0; i < n; i++) {
+      y[i] = log(x[i]);
+    }
+    return;
+  }
+  uint index[VectorMath::BLOCK_SIZE];
+  double value[VectorMath::BLOCK_SIZE];
+  for(uint start = 0; start < n; start += VectorMath::BLOCK_SIZE) {
+    uint end = std::min(n, start + VectorMath::BLOCK_SIZE);
+    // zero, negative, subnormal and non-finite arguments, i.e. if the sign
+    // bit is 1 or the exponent is 0 or 2047.
+    uint m = 0;
+    for(uint i = start; i < end; i++) {
+      if(VectorMath::AsUInt64(x[i]) - VectorMath::MIN_NORMAL_BITS >=
+         VectorMath::INF_BITS - VectorMath::MIN_NORMAL_BITS) {
+        index[m] = i;
+        value[m] = x[i];
+        m++;
+      }
+    }
+    _PRAGMA_OMP_SIMD
+    for(uint i = start; i < end; i++) {
+      y[i] = VectorMath::LogKernel(x[i]);
+    }
+    for(uint k = 0; k < m; k++) {
+      y[index[k]] = log(value[k]);
+    }
+  }
+}
+
+inline void ExpVec(vec const& x, vec& y) {
+  y.resize(x.size());
+  if(x.size() > 0) ExpVec(&x[0], &y[0], x.size());
+}
+
+inline void LogVec(vec const& x, vec& y) {
+  y.resize(x.size());
+  if(x.size() > 0) LogVec(&x[0], &y[0], x.size());
+}
+
+}
+#endif // ThreePointUsingSPLITT_VectorMath_H_